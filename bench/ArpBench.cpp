@@ -0,0 +1,132 @@
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include "ArpCache.h"
+#include "Bench.h"
+#include "RoutingTable.h"
+#include "detail/cxxopts.hpp"
+#include "protocol.h"
+
+namespace {
+
+class DiscardingSender : public IPacketSender {
+   public:
+    void sendPacket(Packet, const std::string&) override {}
+};
+
+struct ReaderResult {
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    std::vector<uint32_t> samples;
+};
+
+// Looks up neighbors until stop is set, timing every 64th lookup
+ReaderResult readNeighbors(ArpCache& cache, const std::vector<ip_addr>& neighbors, size_t offset,
+                           const std::atomic<bool>& stop) {
+    ReaderResult result;
+    result.samples.reserve(1 << 20);
+    for (size_t i = offset; !stop.load(std::memory_order_relaxed); ++i) {
+        ip_addr ip = neighbors[i % neighbors.size()];
+        if (i % 64 == 0 && result.samples.size() < result.samples.capacity()) {
+            auto start = std::chrono::steady_clock::now();
+            bool hit = cache.getEntry(ip).has_value();
+            auto end = std::chrono::steady_clock::now();
+            result.hits += hit;
+            result.samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        } else {
+            result.hits += cache.getEntry(ip).has_value();
+        }
+        ++result.lookups;
+    }
+    return result;
+}
+
+}  // namespace
+
+int benchArp(int argc, char** argv) {
+    cxxopts::Options options("arp", "ARP cache lookups from forwarding threads while entries are evicted");
+    options.add_options()
+        ("threads", "Number of forwarding threads calling getEntry", cxxopts::value<size_t>()->default_value("4"))
+        ("neighbors", "Number of neighbor addresses; more than fit in the table keeps it evicting",
+         cxxopts::value<size_t>()->default_value("8192"))
+        ("capacity", "Neighbor table slots", cxxopts::value<size_t>()->default_value("4096"))
+        ("timeout", "ARP entry timeout in milliseconds", cxxopts::value<size_t>()->default_value("15000"))
+        ("seconds", "Duration of the run", cxxopts::value<double>()->default_value("2"));
+    auto result = options.parse(argc, argv);
+
+    size_t threadCount = result["threads"].as<size_t>();
+    size_t neighborCount = result["neighbors"].as<size_t>();
+    ArpCacheOptions arpOptions;
+    arpOptions.capacity = result["capacity"].as<size_t>();
+    auto timeout = std::chrono::milliseconds(result["timeout"].as<size_t>());
+    auto duration = std::chrono::duration<double>(result["seconds"].as<double>());
+
+    auto routingTable = std::make_shared<RoutingTable>(
+        std::vector<RoutingEntry>{{htonl(0x0A000000), 0, htonl(0xFF000000), "eth1"}}, FibEngine::Dir24_8);
+    routingTable->setRoutingInterface("eth1", {0x02, 0, 0, 0, 0, 1}, htonl(0x0A000001));
+    ArpCache cache(timeout, std::make_shared<DiscardingSender>(), routingTable, arpOptions);
+
+    std::vector<ip_addr> neighbors;
+    for (size_t i = 0; i < neighborCount; ++i) {
+        neighbors.push_back(htonl(0x0A000002 + i));
+    }
+
+    // What the forwarding path queues while a neighbor is unresolved
+    Packet packet(sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + sizeof(sr_icmp_hdr_t), 0);
+    reinterpret_cast<sr_ethernet_hdr_t*>(packet.data())->ether_type = htons(ethertype_ip);
+    auto* ipHeader = reinterpret_cast<sr_ip_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
+    ipHeader->ip_v = 4;
+    ipHeader->ip_hl = 5;
+    ipHeader->ip_ttl = 64;
+
+    // The ARP side: resolve the neighbors round robin. Entries no longer expire within
+    // the run (they are probed first), so it is the full table that makes room for each
+    // new neighbor by evicting one.
+    std::atomic<bool> stop = false;
+    size_t updates = 0;
+    std::thread churn([&] {
+        for (size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+            ip_addr ip = neighbors[i % neighbors.size()];
+            cache.queuePacket(ip, packet, "eth1");
+            cache.addEntry(ip, {0x02, 0, 0, 0, 0, static_cast<uint8_t>(i)});
+            ++updates;
+        }
+    });
+
+    std::vector<ReaderResult> results(threadCount);
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < threadCount; ++t) {
+        readers.emplace_back([&, t] { results[t] = readNeighbors(cache, neighbors, t * 7919, stop); });
+    }
+
+    std::this_thread::sleep_for(duration);
+    uint64_t evictions = cache.neighborEvictions();
+    stop = true;
+    churn.join();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    uint64_t lookups = 0, hits = 0;
+    std::vector<uint32_t> samples;
+    for (const auto& reader : results) {
+        lookups += reader.lookups;
+        hits += reader.hits;
+        samples.insert(samples.end(), reader.samples.begin(), reader.samples.end());
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double quantile) { return samples[quantile * (samples.size() - 1)]; };
+
+    double seconds = duration.count();
+    std::printf("%zu forwarding threads, %zu neighbors, %zu slots, %lld ms timeout\n", threadCount, neighborCount,
+                arpOptions.capacity, static_cast<long long>(timeout.count()));
+    std::printf("%14s %10s %8s %8s %8s %10s %12s %12s\n", "Mlookups/s", "hit rate", "p50 ns", "p99 ns", "p99.9 ns",
+                "max ns", "updates/s", "evictions/s");
+    std::printf("%14.2f %9.1f%% %8u %8u %8u %10u %12.0f %12.0f\n", lookups / seconds / 1e6, 100.0 * hits / lookups,
+                at(0.5), at(0.99), at(0.999), samples.back(), updates / seconds, evictions / seconds);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "IRoutingTable.h"
+#include "RouterTypes.h"
+
+/**
+ * Entry points of the individual benchmarks. Each one receives the arguments that
+ * follow the program name on the command line (argv[0] is the benchmark name) and
+ * return the process exit code.
+ */
+int benchLookup(int argc, char** argv);
+int benchEcmp(int argc, char** argv);
+int benchChurn(int argc, char** argv);
+int benchArp(int argc, char** argv);
+int benchForward(int argc, char** argv);
+int benchBurst(int argc, char** argv);
+int benchChecksum(int argc, char** argv);
+
+/**
+ * @brief Generates a routing table with a prefix length mix resembling a full BGP table
+ * (mostly /24s, some shorter aggregates and a few host routes).
+ * @param count Number of entries to generate.
+ * @param interfaces Number of distinct interfaces (eth0, eth1, ...) the routes point to.
+ */
+std::vector<RoutingEntry> makeRandomRoutes(size_t count, size_t interfaces, std::mt19937& rng);
+
+/**
+ * @brief Picks destinations so that most of them fall inside one of the given routes.
+ */
+std::vector<ip_addr> makeDestinations(const std::vector<RoutingEntry>& routes, size_t count, std::mt19937& rng);
+
+/**
+ * @brief Runs fn once and returns the elapsed wall clock time in nanoseconds.
+ */
+template <typename Fn>
+double measureNs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/**
+ * @brief Keeps the compiler from optimizing away a computed value.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif  // BENCH_H
@@ -0,0 +1,51 @@
+#include <arpa/inet.h>
+
+#include <string>
+
+#include "Bench.h"
+
+std::vector<RoutingEntry> makeRandomRoutes(size_t count, size_t interfaces, std::mt19937& rng) {
+    std::vector<RoutingEntry> routes;
+    routes.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t pick = rng() % 100;
+        uint32_t length;
+        if (pick < 60) {
+            length = 24;
+        }
+        else if (pick < 85) {
+            length = 16 + rng() % 8;
+        }
+        else if (pick < 95) {
+            length = 25 + rng() % 8;
+        }
+        else {
+            length = 8 + rng() % 8;
+        }
+
+        uint32_t mask = length == 0 ? 0 : ~0u << (32 - length);
+        uint32_t dest = rng() & mask;
+        uint32_t gateway = 0x0A000000 | (rng() & 0x00FFFFFF);
+        std::string iface = "eth" + std::to_string(rng() % interfaces);
+        routes.push_back({htonl(dest), htonl(gateway), htonl(mask), iface});
+    }
+
+    return routes;
+}
+
+std::vector<ip_addr> makeDestinations(const std::vector<RoutingEntry>& routes, size_t count, std::mt19937& rng) {
+    std::vector<ip_addr> destinations;
+    destinations.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (routes.empty() || rng() % 10 == 0) {
+            destinations.push_back(rng());
+            continue;
+        }
+        const auto& route = routes[rng() % routes.size()];
+        destinations.push_back(route.dest | (rng() & ~route.mask));
+    }
+
+    return destinations;
+}
@@ -0,0 +1,283 @@
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "Bench.h"
+#include "Checksum.h"
+#include "detail/cxxopts.hpp"
+#include "protocol.h"
+#include "utils.h"
+
+namespace {
+
+constexpr checksum::Kernel KERNELS[] = {checksum::Kernel::Scalar, checksum::Kernel::Sse2, checksum::Kernel::Avx2};
+
+// The byte-at-a-time loop cksum used before the kernels, folded but not complemented
+uint16_t referenceSum(const void* data, size_t len) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint32_t sum = 0;
+    for (; len >= 2; bytes += 2, len -= 2) {
+        sum += bytes[0] << 8 | bytes[1];
+    }
+    if (len > 0) {
+        sum += bytes[0] << 8;
+    }
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return sum;
+}
+
+sr_ip_hdr_t randomHeader(std::mt19937& rng) {
+    sr_ip_hdr_t header;
+    auto* bytes = reinterpret_cast<uint8_t*>(&header);
+    for (size_t i = 0; i < sizeof(header); ++i) {
+        bytes[i] = rng();
+    }
+    header.ip_sum = 0;
+    header.ip_sum = cksum(&header, sizeof(header));
+    return header;
+}
+
+// The forwarding path before incremental updates
+void decrementTtlFull(sr_ip_hdr_t* header) {
+    header->ip_ttl--;
+    header->ip_sum = 0;
+    header->ip_sum = cksum(header, sizeof(sr_ip_hdr_t));
+}
+
+// The header check before in-place verification
+bool isValidCopying(const sr_ip_hdr_t* header) {
+    sr_ip_hdr_t copy = *header;
+    copy.ip_sum = 0;
+    return cksum(&copy, sizeof(copy)) == header->ip_sum;
+}
+
+// Checks ip_decrement_ttl and ip_cksum_valid against the full cksum. Returns the number of mismatches.
+uint64_t checkProperties(size_t iterations, std::mt19937& rng) {
+    uint64_t mismatches = 0;
+    auto report = [&](const char* what, const sr_ip_hdr_t& header) {
+        if (mismatches++ < 10) {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&header);
+            std::printf("mismatch (%s):", what);
+            for (size_t i = 0; i < sizeof(header); ++i) {
+                std::printf(" %02x", bytes[i]);
+            }
+            std::printf("\n");
+        }
+    };
+
+    for (size_t i = 0; i < iterations; ++i) {
+        sr_ip_hdr_t header = randomHeader(rng);
+
+        // Every TTL the router would decrement, on every iteration's random remainder
+        for (int ttl = 1; ttl <= 255; ttl += (i % 16 == 0) ? 1 : 64) {
+            header.ip_ttl = ttl;
+            header.ip_sum = 0;
+            header.ip_sum = cksum(&header, sizeof(header));
+
+            sr_ip_hdr_t incremental = header;
+            sr_ip_hdr_t full = header;
+            ip_decrement_ttl(&incremental);
+            decrementTtlFull(&full);
+            if (std::memcmp(&incremental, &full, sizeof(header)) != 0) {
+                report("ttl update", header);
+            }
+            if (!ip_cksum_valid(&incremental, sizeof(incremental))) {
+                report("valid header rejected", incremental);
+            }
+        }
+
+        // Any single-bit error must be caught
+        sr_ip_hdr_t corrupted = header;
+        size_t bit = rng() % (sizeof(corrupted) * 8);
+        reinterpret_cast<uint8_t*>(&corrupted)[bit / 8] ^= 1 << (bit % 8);
+        if (ip_cksum_valid(&corrupted, sizeof(corrupted))) {
+            report("corrupted header accepted", corrupted);
+        }
+
+        // Arbitrary checksums get the copying check's verdict, except that 0x0000 and 0xffff
+        // are the same value in one's complement and both verify
+        sr_ip_hdr_t arbitrary = header;
+        arbitrary.ip_sum = (i % 4 == 0) ? 0 : static_cast<uint16_t>(rng());
+        bool expected = isValidCopying(&arbitrary) || (arbitrary.ip_sum == 0 && header.ip_sum == 0xffff);
+        if (ip_cksum_valid(&arbitrary, sizeof(arbitrary)) != expected) {
+            report("verdict", arbitrary);
+        }
+    }
+    return mismatches;
+}
+
+// Runs fn over a cache-resident copy of headers, rounds times
+// Checks every supported kernel against referenceSum() on random lengths and alignments.
+// Returns the number of mismatches.
+uint64_t checkKernels(size_t iterations, std::mt19937& rng) {
+    std::vector<uint8_t> buffer(9000 + 8);
+    uint64_t mismatches = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        // Mostly random bytes, sometimes all ones to drive the carries
+        bool ones = i % 8 == 0;
+        for (auto& byte : buffer) {
+            byte = ones ? 0xFF : rng();
+        }
+        size_t offset = rng() % 8;
+        size_t len = (i % 2 == 0) ? rng() % 129 : rng() % 9001;
+        uint16_t expected = referenceSum(buffer.data() + offset, len);
+        for (auto kernel : KERNELS) {
+            if (checksum::isSupported(kernel) && checksum::sum(kernel, buffer.data() + offset, len) != expected) {
+                if (mismatches++ < 10) {
+                    std::printf("mismatch (%s): length %zu, offset %zu\n", checksum::kernelName(kernel), len, offset);
+                }
+            }
+        }
+        if (checksum::sum(buffer.data() + offset, len) != expected) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// Times every kernel on a cache-resident buffer of each length, one row per length
+void benchKernels(size_t bytesPerRun) {
+    std::vector<uint8_t> buffer(9000);
+    std::mt19937 rng(7);
+    for (auto& byte : buffer) {
+        byte = rng();
+    }
+
+    std::printf("\n%8s %12s", "length", "reference");
+    for (auto kernel : KERNELS) {
+        if (checksum::isSupported(kernel)) {
+            std::printf(" %12s", checksum::kernelName(kernel));
+        }
+    }
+    std::printf("   (ns per buffer; GB/s of the fastest)\n");
+
+    for (size_t len : {20, 40, 64, 128, 256, 576, 1500, 4096, 9000}) {
+        size_t runs = std::max<size_t>(bytesPerRun / len, 1);
+        auto time = [&](auto&& sum) {
+            double ns = measureNs([&] {
+                for (size_t run = 0; run < runs; ++run) {
+                    doNotOptimize(sum(buffer.data(), len));
+                }
+            });
+            return ns / runs;
+        };
+
+        double reference = time(referenceSum);
+        double best = reference;
+        std::printf("%8zu %12.1f", len, reference);
+        for (auto kernel : KERNELS) {
+            if (checksum::isSupported(kernel)) {
+                double ns = time([kernel](const void* data, size_t size) { return checksum::sum(kernel, data, size); });
+                best = std::min(best, ns);
+                std::printf(" %12.1f", ns);
+            }
+        }
+        std::printf("   %6.2f\n", len / best);
+    }
+}
+
+// Compares checking scattered headers one by one with checking them as a batch
+void benchBatch(size_t packetCount, size_t rounds, std::mt19937& rng) {
+    // Separately allocated frames, as the bridge delivers them
+    std::vector<Packet> packets;
+    std::vector<const sr_ip_hdr_t*> headers;
+    for (size_t i = 0; i < packetCount; ++i) {
+        sr_ip_hdr_t header = randomHeader(rng);
+        Packet packet(sizeof(sr_ethernet_hdr_t) + 1500);
+        std::memcpy(packet.data() + sizeof(sr_ethernet_hdr_t), &header, sizeof(header));
+        packets.push_back(std::move(packet));
+    }
+    for (const auto& packet : packets) {
+        headers.push_back(reinterpret_cast<const sr_ip_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t)));
+    }
+
+    std::unique_ptr<bool[]> valid(new bool[headers.size()]);
+    uint64_t validCount = 0;
+    double single = measureNs([&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (const auto* header : headers) {
+                validCount += ip_cksum_valid(header, sizeof(sr_ip_hdr_t));
+            }
+        }
+    });
+    double batch = measureNs([&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            validCount += checksum::verifyIpHeaders(headers, std::span<bool>(valid.get(), headers.size()));
+        }
+    });
+    doNotOptimize(validCount);
+
+    double count = headers.size() * rounds;
+    std::printf("\n%zu scattered headers: %.2f ns/header one by one, %.2f ns/header batched\n", headers.size(),
+                single / count, batch / count);
+}
+
+template <typename Fn>
+double nsPerHeader(std::vector<sr_ip_hdr_t> headers, size_t rounds, Fn&& fn) {
+    double ns = measureNs([&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (auto& header : headers) {
+                fn(&header);
+            }
+            doNotOptimize(headers.data());
+        }
+    });
+    return ns / (headers.size() * rounds);
+}
+
+}  // namespace
+
+int benchChecksum(int argc, char** argv) {
+    cxxopts::Options options("checksum", "IP header checksum updates and checks against the full cksum");
+    options.add_options()
+        ("iterations", "Random headers to check", cxxopts::value<size_t>()->default_value("1000000"))
+        ("headers", "Distinct headers per timing run", cxxopts::value<size_t>()->default_value("1024"))
+        ("rounds", "Passes over the headers per timing run", cxxopts::value<size_t>()->default_value("2000"))
+        ("kernel-iterations", "Random buffers to check every kernel on", cxxopts::value<size_t>()->default_value("20000"))
+        ("batch-packets", "Frames per batch verification run", cxxopts::value<size_t>()->default_value("4096"))
+        ("seed", "Random seed", cxxopts::value<uint32_t>()->default_value("1"));
+    auto result = options.parse(argc, argv);
+
+    std::mt19937 rng(result["seed"].as<uint32_t>());
+    size_t iterations = result["iterations"].as<size_t>();
+    uint64_t mismatches = checkProperties(iterations, rng);
+    std::printf("%zu random headers checked against cksum: %lu mismatches\n", iterations, mismatches);
+    size_t kernelIterations = result["kernel-iterations"].as<size_t>();
+    uint64_t kernelMismatches = checkKernels(kernelIterations, rng);
+    std::printf("%zu random buffers checked against the byte loop: %lu mismatches (active kernel: %s)\n",
+                kernelIterations, kernelMismatches, checksum::kernelName(checksum::activeKernel()));
+    mismatches += kernelMismatches;
+
+    std::vector<sr_ip_hdr_t> headers(result["headers"].as<size_t>());
+    for (auto& header : headers) {
+        header = randomHeader(rng);
+        header.ip_ttl |= 1;
+        header.ip_sum = 0;
+        header.ip_sum = cksum(&header, sizeof(header));
+    }
+
+    size_t rounds = result["rounds"].as<size_t>();
+    uint64_t valid = 0;
+    std::printf("%-28s %10s\n", "operation", "ns/header");
+    std::printf("%-28s %10.2f\n", "TTL decrement, full cksum", nsPerHeader(headers, rounds, decrementTtlFull));
+    std::printf("%-28s %10.2f\n", "TTL decrement, incremental", nsPerHeader(headers, rounds, [](sr_ip_hdr_t* header) {
+        ip_decrement_ttl(header);
+    }));
+    std::printf("%-28s %10.2f\n", "verify, copying", nsPerHeader(headers, rounds, [&](sr_ip_hdr_t* header) {
+        valid += isValidCopying(header);
+    }));
+    std::printf("%-28s %10.2f\n", "verify, in place", nsPerHeader(headers, rounds, [&](sr_ip_hdr_t* header) {
+        valid += ip_cksum_valid(header, sizeof(sr_ip_hdr_t));
+    }));
+    doNotOptimize(valid);
+
+    benchKernels(1 << 24);
+    benchBatch(result["batch-packets"].as<size_t>(), rounds / 8, rng);
+
+    return mismatches == 0 ? 0 : 1;
+}
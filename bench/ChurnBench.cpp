@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include "Bench.h"
+#include "RoutingTable.h"
+#include "detail/cxxopts.hpp"
+
+namespace {
+
+struct LatencyStats {
+    double p50, p99, p999, max;
+};
+
+LatencyStats summarize(std::vector<uint32_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double quantile) { return static_cast<double>(samples[quantile * (samples.size() - 1)]); };
+    return {at(0.5), at(0.99), at(0.999), static_cast<double>(samples.back())};
+}
+
+// Times individual lookups on the calling thread until stop is set
+std::vector<uint32_t> sampleLookups(RoutingTable& table, const std::vector<ip_addr>& destinations,
+                                    const std::atomic<bool>& stop) {
+    std::vector<uint32_t> samples;
+    samples.reserve(1 << 24);
+    for (size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+        ip_addr ip = destinations[i % destinations.size()];
+        auto start = std::chrono::steady_clock::now();
+        uint32_t nextHop = table.lookupNextHop(ip);
+        auto end = std::chrono::steady_clock::now();
+        doNotOptimize(nextHop);
+        if (samples.size() < samples.capacity()) {
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+    }
+    return samples;
+}
+
+void printStats(const char* phase, std::vector<uint32_t>& samples) {
+    LatencyStats stats = summarize(samples);
+    std::printf("%-8s %12zu %8.0f %8.0f %8.0f %10.0f\n", phase, samples.size(), stats.p50, stats.p99, stats.p999,
+                stats.max);
+}
+
+}  // namespace
+
+int benchChurn(int argc, char** argv) {
+    cxxopts::Options options("churn", "Route update throughput and lookup latency under churn");
+    options.add_options()
+        ("routes", "Number of routes in the table", cxxopts::value<size_t>()->default_value("500000"))
+        ("seconds", "Duration of each phase", cxxopts::value<double>()->default_value("2"))
+        ("f,fib", "Route lookup engine (linear, dir24-8)", cxxopts::value<std::string>()->default_value("dir24-8"));
+    auto result = options.parse(argc, argv);
+
+    size_t routeCount = result["routes"].as<size_t>();
+    auto duration = std::chrono::duration<double>(result["seconds"].as<double>());
+    FibEngine engine = parseFibEngine(result["fib"].as<std::string>());
+
+    std::mt19937 rng(489);
+    auto routes = makeRandomRoutes(routeCount, 4, rng);
+    auto destinations = makeDestinations(routes, 1 << 20, rng);
+    // Prefixes announced and withdrawn during the churn phase, drawn from the same mix
+    auto churnRoutes = makeRandomRoutes(std::max<size_t>(routeCount / 10, 1), 4, rng);
+
+    RoutingTable table(routes, engine);
+
+    std::printf("%zu routes, %s engine\n", routeCount, fibEngineName(engine));
+    std::printf("%-8s %12s %8s %8s %8s %10s\n", "phase", "lookups", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+
+    // Lookups alone
+    std::atomic<bool> stop = false;
+    std::thread timer([&] {
+        std::this_thread::sleep_for(duration);
+        stop = true;
+    });
+    auto idle = sampleLookups(table, destinations, stop);
+    timer.join();
+    printStats("idle", idle);
+
+    // Lookups while another thread withdraws existing routes and announces new ones
+    stop = false;
+    size_t updates = 0;
+    double updateNs = 0;
+    std::thread writer([&] {
+        auto start = std::chrono::steady_clock::now();
+        std::mt19937 writerRng(4890);
+        while (std::chrono::steady_clock::now() - start < duration) {
+            const RoutingEntry& withdrawn = routes[writerRng() % routes.size()];
+            const RoutingEntry& announced = churnRoutes[writerRng() % churnRoutes.size()];
+            table.removeRoute(withdrawn.dest, withdrawn.mask);
+            table.addRoute(announced.dest, announced.gateway, announced.mask, announced.iface);
+            table.addRoute(withdrawn.dest, withdrawn.gateway, withdrawn.mask, withdrawn.iface);
+            table.removeRoute(announced.dest, announced.mask);
+            updates += 4;
+        }
+        updateNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        stop = true;
+    });
+    auto churn = sampleLookups(table, destinations, stop);
+    writer.join();
+    printStats("churn", churn);
+
+    std::printf("\n%zu updates, %.0f updates/s, %.2f us/update\n", updates, updates / (updateNs / 1e9),
+                updateNs / updates / 1e3);
+    return 0;
+}
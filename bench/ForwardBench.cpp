@@ -0,0 +1,301 @@
+#include <arpa/inet.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "ArpCache.h"
+#include "Bench.h"
+#include "RoutingTable.h"
+#include "StaticRouter.h"
+#include "detail/cxxopts.hpp"
+#include "protocol.h"
+#include "utils.h"
+
+namespace {
+
+// Allocations and copies made by the measuring thread while counting is on
+thread_local bool counting = false;
+thread_local uint64_t allocations = 0;
+thread_local uint64_t allocatedBytes = 0;
+thread_local uint64_t copiedBytes = 0;
+
+class DiscardingSender : public IPacketSender {
+   public:
+    void sendPacket(Packet packet, const std::string&) override { doNotOptimize(packet.data()); }
+};
+
+struct PathResult {
+    double nsPerPacket;
+    double allocationsPerPacket;
+    double allocatedBytesPerPacket;
+    double copiedBytesPerPacket;
+};
+
+template <typename Fn>
+PathResult measurePath(std::vector<Packet>& packets, Fn&& forward) {
+    allocations = 0;
+    allocatedBytes = 0;
+    copiedBytes = 0;
+    counting = true;
+    double ns = measureNs([&] {
+        for (Packet& packet : packets) {
+            forward(std::move(packet));
+        }
+    });
+    counting = false;
+    double count = packets.size();
+    return {ns / count, allocations / count, allocatedBytes / count, copiedBytes / count};
+}
+
+// The forwarding path before frames were rewritten in place: a new frame is
+// allocated and zeroed, and the IP packet is copied into it
+void rebuildFrame(Packet packet, const mac_addr& sourceMAC, const mac_addr& nextHopMAC, IPacketSender& sender) {
+    auto* ipHeader = reinterpret_cast<sr_ip_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
+    ipHeader->ip_ttl--;
+    ipHeader->ip_sum = 0;
+    ipHeader->ip_sum = cksum(ipHeader, sizeof(sr_ip_hdr));
+
+    Packet frame(sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + ntohs(ipHeader->ip_len), 0);
+    auto* ethHeader = reinterpret_cast<sr_ethernet_hdr_t*>(frame.data());
+    std::memcpy(ethHeader->ether_shost, sourceMAC.data(), ETHER_ADDR_LEN);
+    std::memcpy(ethHeader->ether_dhost, nextHopMAC.data(), ETHER_ADDR_LEN);
+    ethHeader->ether_type = htons(ethertype_ip);
+    std::memcpy(frame.data() + sizeof(sr_ethernet_hdr_t), ipHeader, ntohs(ipHeader->ip_len));
+    sender.sendPacket(frame, "eth1");
+}
+
+// A UDP packet from 192.168.1.2; destination in host byte order
+Packet makeFrame(size_t size, uint32_t destination = 0x0A010203) {
+    Packet frame(size, 0);
+    reinterpret_cast<sr_ethernet_hdr_t*>(frame.data())->ether_type = htons(ethertype_ip);
+    auto* ipHeader = reinterpret_cast<sr_ip_hdr_t*>(frame.data() + sizeof(sr_ethernet_hdr_t));
+    ipHeader->ip_v = 4;
+    ipHeader->ip_hl = 5;
+    ipHeader->ip_ttl = 64;
+    ipHeader->ip_p = ip_protocol_udp;
+    ipHeader->ip_len = htons(size - sizeof(sr_ethernet_hdr_t));
+    ipHeader->ip_src = htonl(0xC0A80102);
+    ipHeader->ip_dst = htonl(destination);
+    ipHeader->ip_sum = cksum(ipHeader, sizeof(sr_ip_hdr_t));
+    return frame;
+}
+
+void* countedAllocate(size_t size, std::align_val_t alignment = std::align_val_t{__STDCPP_DEFAULT_NEW_ALIGNMENT__}) {
+    if (counting) {
+        allocations++;
+        allocatedBytes += size;
+    }
+    size_t align = static_cast<size_t>(alignment);
+    size = size == 0 ? 1 : size;
+    void* memory = align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? std::malloc(size)
+                                                             : std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+}  // namespace
+
+// Every replaceable allocation function goes through malloc() and free(), so
+// whichever form the library picks is counted and released by its pair. GCC
+// still flags free() on memory from operator new once the pair is inlined.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t size) {
+    return countedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+    return countedAllocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return countedAllocate(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return countedAllocate(size, alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return countedAllocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return countedAllocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+#pragma GCC diagnostic pop
+
+// The bench links with --wrap=memcpy and --wrap=memmove, so every copy that is
+// a library call lands here, including the ones std::vector makes. Fixed-size
+// copies the compiler inlines, such as the MAC addresses, are not seen.
+extern "C" {
+void* __real_memcpy(void* destination, const void* source, size_t size);
+void* __real_memmove(void* destination, const void* source, size_t size);
+
+void* __wrap_memcpy(void* destination, const void* source, size_t size) {
+    if (counting) {
+        copiedBytes += size;
+    }
+    return __real_memcpy(destination, source, size);
+}
+
+void* __wrap_memmove(void* destination, const void* source, size_t size) {
+    if (counting) {
+        copiedBytes += size;
+    }
+    return __real_memmove(destination, source, size);
+}
+}
+
+int benchForward(int argc, char** argv) {
+    cxxopts::Options options("forward", "Allocations and copies per forwarded frame, in place versus rebuilt");
+    options.add_options()
+        ("packets", "Frames forwarded per size and path", cxxopts::value<size_t>()->default_value("200000"));
+    auto result = options.parse(argc, argv);
+    size_t count = result["packets"].as<size_t>();
+
+    mac_addr sourceMAC = {0x02, 0, 0, 0, 0, 1};
+    mac_addr nextHopMAC = {0x02, 0, 0, 0, 0, 2};
+    DiscardingSender sender;
+
+    // Both paths only rewrite and send; the lookups before them are the same either way
+    std::printf("%zu frames per size and path; copy B counts the bytes passed to memcpy() and memmove()\n", count);
+    std::printf("%8s %10s %10s %12s %12s %12s\n", "frame B", "path", "ns/frame", "allocs/frame", "alloc B/frame",
+                "copy B/frame");
+    for (size_t size : {64, 576, 1500, 9000}) {
+        Packet frame = makeFrame(size);
+
+        std::vector<Packet> packets(count, frame);
+        PathResult rebuilt = measurePath(packets, [&](Packet packet) {
+            rebuildFrame(std::move(packet), sourceMAC, nextHopMAC, sender);
+        });
+        std::printf("%8zu %10s %10.1f %12.2f %12.0f %12.0f\n", size, "rebuild", rebuilt.nsPerPacket,
+                    rebuilt.allocationsPerPacket, rebuilt.allocatedBytesPerPacket, rebuilt.copiedBytesPerPacket);
+
+        packets.assign(count, frame);
+        PathResult inPlace = measurePath(packets, [&](Packet packet) {
+            if (rewrite_for_next_hop(packet, sourceMAC, nextHopMAC)) {
+                sender.sendPacket(std::move(packet), "eth1");
+            }
+        });
+        std::printf("%8zu %10s %10.1f %12.2f %12.0f %12.0f\n", size, "in place", inPlace.nsPerPacket,
+                    inPlace.allocationsPerPacket, inPlace.allocatedBytesPerPacket, inPlace.copiedBytesPerPacket);
+    }
+    return 0;
+}
+
+int benchBurst(int argc, char** argv) {
+    cxxopts::Options options("burst", "Forwarding throughput of handlePackets() by burst size");
+    options.add_options()
+        ("packets", "Frames forwarded per burst size", cxxopts::value<size_t>()->default_value("262144"))
+        ("destinations", "Distinct destination hosts, spread over two egress interfaces", cxxopts::value<size_t>()->default_value("64"))
+        ("size", "Frame size in bytes", cxxopts::value<size_t>()->default_value("64"));
+    auto result = options.parse(argc, argv);
+    size_t count = result["packets"].as<size_t>();
+    size_t destinationCount = result["destinations"].as<size_t>();
+    size_t size = result["size"].as<size_t>();
+
+    auto routingTable = std::make_shared<RoutingTable>(
+        std::vector<RoutingEntry>{{htonl(0x0A000000), htonl(0x0A000002), htonl(0xFF000000), "eth1"},
+                                  {htonl(0xAC100000), htonl(0xAC100002), htonl(0xFFF00000), "eth2"}},
+        FibEngine::Dir24_8);
+    routingTable->setRoutingInterfaces({{"eth0", {0x02, 0, 0, 0, 0, 9}, htonl(0xC0A80101)},
+                                        {"eth1", {0x02, 0, 0, 0, 0, 1}, htonl(0x0A000001)},
+                                        {"eth2", {0x02, 0, 0, 0, 1, 1}, htonl(0xAC100001)}});
+    auto sender = std::make_shared<DiscardingSender>();
+    auto arpCache = std::make_unique<ArpCache>(std::chrono::seconds(60), sender, routingTable);
+    arpCache->addEntry(htonl(0x0A000002), {0x02, 0, 0, 0, 0, 2});
+    arpCache->addEntry(htonl(0xAC100002), {0x02, 0, 0, 0, 1, 2});
+    StaticRouter router(std::move(arpCache), routingTable, sender);
+
+    // Alternate between the two egress interfaces so every burst has to be grouped
+    std::vector<Packet> frames;
+    for (size_t i = 0; i < count; ++i) {
+        size_t host = i % destinationCount;
+        frames.push_back(makeFrame(size, (host % 2 ? 0xAC100100 : 0x0A010100) + host));
+    }
+
+    std::vector<Packet> packets;
+    std::string iface = "eth0";
+    packets = frames;
+    double single = measureNs([&] {
+        for (Packet& packet : packets) {
+            router.handlePacket(std::move(packet), iface);
+        }
+    });
+
+    std::printf("%zu frames of %zu bytes to %zu destinations; handlePacket() one at a time: %.1f ns/frame\n", count,
+                size, destinationCount, single / count);
+    std::printf("%8s %10s %10s %10s\n", "burst", "ns/frame", "Mpps", "speedup");
+    for (size_t burst : {1, 2, 4, 8, 16, 32, 64, 128, 256}) {
+        packets = frames;
+        std::vector<PacketRef> refs;
+        refs.reserve(count);
+        for (Packet& packet : packets) {
+            refs.push_back({packet, iface});
+        }
+
+        double ns = measureNs([&] {
+            for (size_t base = 0; base < count; base += burst) {
+                router.handlePackets(std::span(refs).subspan(base, std::min(burst, count - base)));
+            }
+        });
+        std::printf("%8zu %10.1f %10.2f %9.2fx\n", burst, ns / count, count / ns * 1000, single / ns);
+    }
+    return 0;
+}
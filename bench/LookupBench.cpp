@@ -0,0 +1,131 @@
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Bench.h"
+#include "RoutingTable.h"
+#include "detail/cxxopts.hpp"
+#include "utils.h"
+
+int benchLookup(int argc, char** argv) {
+    cxxopts::Options options("lookup", "Route lookup cost per address for several batch sizes");
+    options.add_options()
+        ("routes", "Number of routes in the table", cxxopts::value<size_t>()->default_value("500000"))
+        ("lookups", "Number of addresses looked up per batch size", cxxopts::value<size_t>()->default_value("4000000"))
+        ("hot", "Number of distinct destinations in the route cache run", cxxopts::value<size_t>()->default_value("1000"))
+        ("f,fib", "Route lookup engine (linear, dir24-8)", cxxopts::value<std::string>()->default_value("dir24-8"));
+    auto result = options.parse(argc, argv);
+
+    size_t routeCount = result["routes"].as<size_t>();
+    size_t lookupCount = result["lookups"].as<size_t>();
+    size_t hotCount = result["hot"].as<size_t>();
+    FibEngine engine = parseFibEngine(result["fib"].as<std::string>());
+
+    std::mt19937 rng(489);
+    auto routes = makeRandomRoutes(routeCount, 4, rng);
+    auto destinations = makeDestinations(routes, lookupCount, rng);
+
+    RoutingTable table(routes, engine);
+    std::vector<uint32_t> results(destinations.size());
+
+    std::printf("%zu routes, %zu lookups, %s engine\n", routeCount, lookupCount, fibEngineName(engine));
+    std::printf("%10s %12s %14s\n", "batch", "ns/lookup", "Mlookups/s");
+
+    for (size_t batch : {1, 8, 32, 256}) {
+        std::span<const ip_addr> ips(destinations);
+        std::span<uint32_t> out(results);
+
+        double ns = measureNs([&] {
+            for (size_t base = 0; base < ips.size(); base += batch) {
+                size_t count = std::min(batch, ips.size() - base);
+                table.lookupBatch(ips.subspan(base, count), out.subspan(base, count));
+            }
+        });
+        doNotOptimize(results.back());
+
+        double perLookup = ns / destinations.size();
+        std::printf("%10zu %12.2f %14.2f\n", batch, perLookup, 1e3 / perLookup);
+    }
+
+    // Single lookups with the traffic concentrated on a few destinations, with and
+    // without a destination cache in front of the FIB
+    std::vector<ip_addr> hot(destinations.begin(), destinations.begin() + std::min(hotCount, destinations.size()));
+    std::vector<ip_addr> skewed(lookupCount);
+    for (auto& ip : skewed) {
+        ip = hot[rng() % hot.size()];
+    }
+
+    std::printf("\n%zu distinct destinations\n", hot.size());
+    std::printf("%10s %12s %14s %10s\n", "", "ns/lookup", "Mlookups/s", "hit rate");
+    RouteCache cache;
+    for (bool cached : {false, true}) {
+        double ns = measureNs([&] {
+            for (size_t i = 0; i < skewed.size(); ++i) {
+                results[i] = cached ? table.lookupNextHop(skewed[i], 0, cache) : table.lookupNextHop(skewed[i]);
+            }
+        });
+        doNotOptimize(results.back());
+
+        double perLookup = ns / skewed.size();
+        double hitRate = cached ? 100.0 * cache.hits() / (cache.hits() + cache.misses()) : 0;
+        std::printf("%10s %12.2f %14.2f %9.1f%%\n", cached ? "cached" : "uncached", perLookup, 1e3 / perLookup,
+                    hitRate);
+    }
+
+    return 0;
+}
+
+int benchEcmp(int argc, char** argv) {
+    cxxopts::Options options("ecmp", "Share of flows each member of an equal-cost route receives");
+    options.add_options()
+        ("flows", "Number of synthetic TCP and UDP flows", cxxopts::value<size_t>()->default_value("30000"))
+        ("paths", "Number of equal-cost next hops", cxxopts::value<size_t>()->default_value("3"))
+        ("tolerance", "Largest accepted deviation from an even split, in percentage points",
+         cxxopts::value<double>()->default_value("1.0"));
+    auto result = options.parse(argc, argv);
+
+    size_t flowCount = result["flows"].as<size_t>();
+    size_t pathCount = result["paths"].as<size_t>();
+    double tolerance = result["tolerance"].as<double>();
+
+    // One prefix covering every destination, listed once per next hop
+    std::vector<RoutingEntry> routes;
+    for (size_t i = 0; i < pathCount; ++i) {
+        routes.push_back({htonl(0x0A000000), htonl(0xC0A80001 + i), htonl(0xFF000000), "eth" + std::to_string(i)});
+    }
+    RoutingTable table(routes, FibEngine::Dir24_8);
+
+    // Hash the headers the router hashes: an IP header followed by the ports
+    std::mt19937 rng(489);
+    std::vector<size_t> flowsPerPath(pathCount);
+    uint8_t header[sizeof(sr_ip_hdr_t) + 4]{};
+    auto* ipHeader = reinterpret_cast<sr_ip_hdr_t*>(header);
+    ipHeader->ip_hl = 5;
+    ipHeader->ip_v = 4;
+    for (size_t i = 0; i < flowCount; ++i) {
+        ipHeader->ip_p = (i % 2) ? ip_protocol_tcp : ip_protocol_udp;
+        ipHeader->ip_src = htonl(0xAC100000 | (rng() & 0xFFFFF));
+        ipHeader->ip_dst = htonl(0x0A000000 | (rng() & 0xFFFFFF));
+        uint32_t ports = rng();
+        std::memcpy(header + sizeof(sr_ip_hdr_t), &ports, sizeof(ports));
+
+        uint32_t nextHop = table.lookupNextHop(ipHeader->ip_dst, flow_hash(header, sizeof(header)));
+        flowsPerPath[nextHop]++;
+    }
+
+    std::printf("%zu flows over %zu equal-cost next hops\n", flowCount, pathCount);
+    std::printf("%10s %10s %10s\n", "next hop", "flows", "share");
+    double even = 100.0 / pathCount;
+    double worst = 0;
+    for (size_t i = 0; i < pathCount; ++i) {
+        double share = 100.0 * flowsPerPath[i] / flowCount;
+        worst = std::max(worst, std::abs(share - even));
+        std::printf("%10zu %10zu %9.1f%%\n", i, flowsPerPath[i], share);
+    }
+    std::printf("largest deviation from %.1f%%: %.2f points\n", even, worst);
+
+    return worst <= tolerance ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#include <spdlog/spdlog.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "Bench.h"
+
+namespace {
+
+struct Benchmark {
+    const char* name;
+    const char* description;
+    int (*run)(int argc, char** argv);
+};
+
+constexpr Benchmark BENCHMARKS[] = {
+    {"lookup", "Route lookup cost per address for batch sizes 1/8/32/256", benchLookup},
+    {"ecmp", "Share of synthetic flows each equal-cost next hop receives", benchEcmp},
+    {"churn", "Route update throughput and lookup tail latency while routes change", benchChurn},
+    {"arp", "ARP cache lookup throughput and latency from N threads while entries are evicted", benchArp},
+    {"forward", "Allocations, copies and time per forwarded frame, in place versus rebuilt", benchForward},
+    {"burst", "Forwarding throughput of handlePackets() for burst sizes 1-256", benchBurst},
+    {"checksum", "Checksum kernels for 20-9000 bytes, batch header checks and TTL updates, verified", benchChecksum},
+};
+
+void usage(const char* program) {
+    std::printf("Usage: %s <benchmark> [options]\n\nBenchmarks:\n", program);
+    for (const auto& benchmark : BENCHMARKS) {
+        std::printf("  %-12s %s\n", benchmark.name, benchmark.description);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Keep the router's per-packet logging out of the measurements
+    spdlog::set_level(spdlog::level::warn);
+
+    for (const auto& benchmark : BENCHMARKS) {
+        if (std::strcmp(argv[1], benchmark.name) == 0) {
+            return benchmark.run(argc - 1, argv + 1);
+        }
+    }
+
+    usage(argv[0]);
+    return 1;
+}
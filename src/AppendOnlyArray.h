@@ -0,0 +1,89 @@
+#ifndef APPENDONLYARRAY_H
+#define APPENDONLYARRAY_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+/**
+ * @class AppendOnlyArray
+ * @brief A growable array whose elements never move, readable without locks.
+ *
+ * Elements live in fixed-size chunks that are allocated on demand and only freed with
+ * the array, so references stay valid and an index handed out once keeps its meaning
+ * for good. A single writer (or writers serialized by the caller) appends; any number
+ * of threads may read the elements that were appended before they obtained the index.
+ */
+template <typename T, size_t ChunkBits = 10, size_t MaxChunks = 4096>
+class AppendOnlyArray {
+   public:
+    static constexpr size_t CHUNK_SIZE = size_t{1} << ChunkBits;
+    static constexpr size_t CAPACITY = CHUNK_SIZE * MaxChunks;
+
+    AppendOnlyArray() = default;
+
+    ~AppendOnlyArray() {
+        for (auto& chunk : chunks) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    AppendOnlyArray(const AppendOnlyArray&) = delete;
+    AppendOnlyArray& operator=(const AppendOnlyArray&) = delete;
+
+    const T& operator[](size_t index) const {
+        return chunks[index >> ChunkBits].load(std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+    }
+
+    T& operator[](size_t index) {
+        return chunks[index >> ChunkBits].load(std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+    }
+
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Appends an element and returns its index.
+     * @throws std::length_error if the array is full.
+     */
+    size_t push_back(T value) {
+        size_t index = count.load(std::memory_order_relaxed);
+        slot(index) = std::move(value);
+        count.store(index + 1, std::memory_order_release);
+        return index;
+    }
+
+    /**
+     * @brief Appends a value-initialized element and returns its index. Works for
+     * elements that cannot be moved, such as atomics.
+     * @throws std::length_error if the array is full.
+     */
+    size_t emplace_back() {
+        size_t index = count.load(std::memory_order_relaxed);
+        slot(index);
+        count.store(index + 1, std::memory_order_release);
+        return index;
+    }
+
+   private:
+    // Returns the storage for the next element, allocating its chunk if needed
+    T& slot(size_t index) {
+        if (index >= CAPACITY) {
+            throw std::length_error("AppendOnlyArray is full");
+        }
+
+        auto& chunk = chunks[index >> ChunkBits];
+        T* elements = chunk.load(std::memory_order_relaxed);
+        if (!elements) {
+            elements = new T[CHUNK_SIZE]();
+            chunk.store(elements, std::memory_order_release);
+        }
+        return elements[index & (CHUNK_SIZE - 1)];
+    }
+
+    std::array<std::atomic<T*>, MaxChunks> chunks{};
+    std::atomic<size_t> count{0};
+};
+
+#endif  // APPENDONLYARRAY_H
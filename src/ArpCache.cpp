@@ -1,30 +1,233 @@
 #include "ArpCache.h"
 
+#include <arpa/inet.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <cstring>
-#include <iostream>
+#include <stdexcept>
 #include <thread>
 
 #include "protocol.h"
 #include "utils.h"
 
-ArpCache::ArpCache(std::chrono::milliseconds timeout, std::shared_ptr<IPacketSender> packetSender, std::shared_ptr<IRoutingTable> routingTable)
-    : timeout(timeout), packetSender(std::move(packetSender)), routingTable(std::move(routingTable)) {
+namespace {
+
+// Formats an address in network byte order for the log
+std::string dotted(ip_addr ip) {
+    char address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &ip, address, sizeof(address));
+    return address;
+}
+
+}  // namespace
+
+ArpCache::ArpCache(std::chrono::milliseconds timeout, std::shared_ptr<IPacketSender> packetSender, std::shared_ptr<IRoutingTable> routingTable,
+                   ArpCacheOptions options)
+    : timeout(timeout), holdDown(options.holdDown), broadcastRate(options.broadcastRate),
+      broadcastBurst(static_cast<double>(options.broadcastBurst)), snapshotPath(std::move(options.snapshotPath)),
+      snapshotInterval(options.snapshotInterval), learnNeighbors(options.learnNeighbors), epoch(Clock::now()), packetSender(std::move(packetSender)), routingTable(std::move(routingTable)),
+      neighbors(options.capacity), pendingPackets(options.pending) {
+    if (!(broadcastRate > 0) || broadcastBurst < 1) {
+        throw std::invalid_argument("ARP broadcast rate and burst must be positive");
+    }
+    if (!snapshotPath.empty()) {
+        if (snapshotInterval.count() <= 0) {
+            throw std::invalid_argument("ARP snapshot interval must be positive");
+        }
+        schedule(epoch + snapshotInterval, 0, Deadline::SnapshotSave);
+    }
     thread = std::make_unique<std::thread>(&ArpCache::loop, this);
 }
 
 ArpCache::~ArpCache() {
-    shutdown = true;
+    {
+        std::unique_lock lock(mutex);
+        shutdown = true;
+    }
+    wakeup.notify_all();
     if (thread && thread->joinable()) {
         thread->join();
     }
+
+    if (!snapshotPath.empty()) {
+        std::vector<NeighborRecord> records;
+        {
+            std::unique_lock lock(mutex);
+            records = snapshotRecords();
+        }
+        saveSnapshot(records);
+    }
 }
 
 void ArpCache::loop() {
+    std::unique_lock lock(mutex);
     while (!shutdown) {
-        tick();
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (deadlines.empty()) {
+            wakeup.wait(lock);
+        } else {
+            // Copy the time: the heap may reallocate while the lock is released
+            Clock::time_point next = deadlines.top().when;
+            wakeup.wait_until(lock, next);
+        }
+        runExpired(Clock::now());
+
+        if (snapshotDue) {
+            snapshotDue = false;
+            std::vector<NeighborRecord> records = snapshotRecords();
+
+            // Forwarding threads may need the mutex while the file is written
+            lock.unlock();
+            saveSnapshot(records);
+            lock.lock();
+        }
+    }
+}
+
+void ArpCache::schedule(Clock::time_point when, ip_addr ip, Deadline::Kind kind) {
+    bool earliest = deadlines.empty() || when < deadlines.top().when;
+    deadlines.push({when, ip, kind});
+    if (earliest) {
+        wakeup.notify_one();
+    }
+}
+
+uint32_t ArpCache::stampOf(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time - epoch).count();
+}
+
+void ArpCache::runExpired(Clock::time_point now) {
+    while (!deadlines.empty() && deadlines.top().when <= now) {
+        Deadline deadline = deadlines.top();
+        deadlines.pop();
+
+        // Skip deadlines that were overtaken by a reply, a refresh or a newer request
+        if (deadline.kind == Deadline::RequestRetry) {
+            auto it = requests.find(deadline.ip);
+            if (it != requests.end() && !it->second.queued && now - it->second.lastSent >= RETRY_INTERVAL) {
+                sendArpRequest(deadline.ip);
+            }
+        } else if (deadline.kind == Deadline::NeighborCheck) {
+            checkNeighbor(deadline.ip, now);
+        } else if (deadline.kind == Deadline::HoldDownExpiry) {
+            auto it = unreachable.find(deadline.ip);
+            if (it != unreachable.end() && it->second.until <= now) {
+                unreachable.erase(it);
+                if (pinned.contains(deadline.ip)) {
+                    resolve(deadline.ip);
+                }
+            }
+        }
+        else if (deadline.kind == Deadline::GatewayRetry) {
+            if (pinned.contains(deadline.ip)) {
+                resolve(deadline.ip);
+            }
+        }
+        else if (deadline.kind == Deadline::SnapshotSave) {
+            snapshotDue = true;
+            schedule(now + snapshotInterval, 0, Deadline::SnapshotSave);
+        }
+        // BurstPacing deadlines only wake the thread up for the bursts below
+    }
+
+    // Everything that came due goes out together, one burst per interface
+    flushBursts(now);
+}
+
+std::chrono::milliseconds ArpCache::refreshAfter() const {
+    // Leave room for every probe before the timeout, unless the timeout is too short for that
+    std::chrono::milliseconds probing = MAX_PROBES * RETRY_INTERVAL;
+    return timeout > 2 * probing ? timeout - probing : timeout / 2;
+}
+
+void ArpCache::checkNeighbor(ip_addr ip, Clock::time_point now) {
+    // Gone if removed, or evicted to make room for another neighbor
+    std::optional<uint32_t> confirmed = neighbors.stampOf(ip);
+    if (!confirmed) {
+        return;
+    }
+
+    // Stamps wrap after 49 days; the difference stays right for any shorter timeout
+    std::chrono::milliseconds age(stampOf(now) - *confirmed);
+    NeighborStatus status = *statusOf(ip);
+
+    switch (status.state) {
+        case NeighborState::Reachable:
+            if (age < refreshAfter()) {
+                return;  // Confirmed again since this check was scheduled
+            }
+            if (neighbors.takeUsed(ip) || pinned.contains(ip)) {
+                status.state = NeighborState::Probe;
+                status.probesSent = 0;
+                sendProbe(ip, status, now);
+            } else {
+                status.state = NeighborState::Stale;
+                schedule(now + (timeout - age), ip, Deadline::NeighborCheck);
+            }
+            neighbors.setNote(ip, toNote(status));
+            break;
+
+        case NeighborState::Stale:
+            if (age < timeout) {
+                return;
+            }
+            if (neighbors.takeUsed(ip) || pinned.contains(ip)) {
+                status.state = NeighborState::Probe;
+                status.probesSent = 0;
+                sendProbe(ip, status, now);
+                neighbors.setNote(ip, toNote(status));
+            } else {
+                spdlog::info("Neighbor {} unused for {} ms. Removing it.", ntohl(ip), age.count());
+                eraseNeighbor(ip);
+            }
+            break;
+
+        case NeighborState::Probe:
+            // Restored neighbors enter PROBE without a probe sent
+            if (status.probesSent > 0 && std::chrono::milliseconds(stampOf(now) - status.lastProbe) < RETRY_INTERVAL) {
+                return;
+            }
+            if (status.probesSent >= MAX_PROBES) {
+                spdlog::warn("Neighbor {} did not answer {} probes. Removing it.", ntohl(ip), status.probesSent);
+                eraseNeighbor(ip);
+                if (pinned.contains(ip)) {
+                    resolve(ip);
+                }
+            } else {
+                sendProbe(ip, status, now);
+                neighbors.setNote(ip, toNote(status));
+            }
+            break;
+    }
+}
+
+void ArpCache::sendProbe(ip_addr ip, NeighborStatus& status, Clock::time_point now) {
+    spdlog::info("Probing neighbor {} ({} of {}).", ntohl(ip), status.probesSent + 1, MAX_PROBES);
+    transmitArpRequest(ip, *neighbors.macOf(ip));
+    status.probesSent++;
+    status.lastProbe = stampOf(now);
+    schedule(now + RETRY_INTERVAL, ip, Deadline::NeighborCheck);
+}
+
+std::optional<ArpCache::NeighborStatus> ArpCache::statusOf(ip_addr ip) const {
+    std::optional<uint64_t> note = neighbors.noteOf(ip);
+    if (!note) {
+        return std::nullopt;
+    }
+    return std::bit_cast<NeighborStatus>(*note);
+}
+
+void ArpCache::eraseNeighbor(ip_addr ip) {
+    neighbors.erase(ip);
+}
+
+void ArpCache::resolve(ip_addr ip) {
+    if (neighbors.stampOf(ip) || unreachable.contains(ip)) {
+        return;
+    }
+    auto [it, created] = requests.try_emplace(ip);
+    if (created) {
+        sendArpRequest(ip);
     }
 }
 
@@ -33,92 +236,165 @@ void ArpCache::loop() {
  * @brief Sends an ARP request to resolve the MAC address for a given destination IP.
  *
  * If an ARP request for the IP exists, it resends the request (up to 7 times).
- * The request is sent using the appropriate network interface and the source
- * IP/MAC address from the routing table. The ARP request is broadcast to
- * resolve the target MAC address.
+ * The request joins the burst of the outgoing interface found in the routing
+ * table; flushBursts() then broadcasts it from the interface's request template
+ * once the broadcast budget allows.
  *
  * @param dest_ip The destination IP address to resolve.
  */
 void ArpCache::sendArpRequest(const uint32_t dest_ip) {
     auto it = requests.find(dest_ip);
     if (it == requests.end()) {
-        std::cout << "Error: This should not happen" << std::endl;
+        spdlog::error("No ARP request pending for IP {}.", dotted(dest_ip));
         return;
     }
     else {
-        ArpRequest& request = it->second;
+        PendingRequest& request = it->second;
 
         if (request.timesSent >= 7) {
             spdlog::warn("ARP request for IP {} failed after 7 attempts. Sending ICMP Host Unreachable.", ntohl(dest_ip));
 
             // send ICMP dest host unreachable
-            handleFailedArpRequest(request);
+            handleFailedArpRequest(dest_ip);
 
             // Drop the request if failed 7 times without a response
-            requests.erase(it);
+            eraseRequest(it);
+            holdDownNextHop(dest_ip, Clock::now());
         }
-        else {
-            // Resend the ARP request and update the metadata
-            auto routingEntryOpt = routingTable->getRoutingEntry(dest_ip);
-
-            if (routingEntryOpt) {
-                // If a valid routing entry is found, use its interface to send the ARP request
-                const RoutingEntry& routingEntry = routingEntryOpt.value();
-                std::string iface = routingEntry.iface;
-
-                RoutingInterface interface = routingTable->getRoutingInterface(iface);
-                ip_addr source_ip = interface.ip;
-                mac_addr source_mac = interface.mac;
-
-                // Ethernet header
-                struct sr_ethernet_hdr ether_hdr;
-                memset(&ether_hdr, 0, sizeof(ether_hdr));
-                memset(ether_hdr.ether_dhost, 0xFF, ETHER_ADDR_LEN);               // Set destination MAC to broadcast address
-                memcpy(ether_hdr.ether_shost, source_mac.data(), ETHER_ADDR_LEN);  // Set source MAC address
-                ether_hdr.ether_type = htons(ethertype_arp);                       // Set EtherType to ARP (0x0806)
-
-                // ARP header
-                struct sr_arp_hdr arp_hdr;
-                memset(&arp_hdr, 0, sizeof(arp_hdr));
-                arp_hdr.ar_hrd = htons(arp_hrd_ethernet);                   // Set hardware type to Ethernet (1)
-                arp_hdr.ar_pro = htons(0x0800);                             // Set protocol type to IPv4 (0x0800)
-                arp_hdr.ar_hln = 6;                                         // Set hardware address length (6 for MAC)
-                arp_hdr.ar_pln = 4;                                         // Set protocol address length (4 for IPv4)
-                arp_hdr.ar_op = htons(arp_op_request);                      // Set ARP operation to request (1)
-                memcpy(arp_hdr.ar_sha, source_mac.data(), ETHER_ADDR_LEN);  // Set sender's MAC address (your MAC address)
-                arp_hdr.ar_sip = source_ip;                                 // Set sender's IP address (your IP address, convert from string)
-                memset(arp_hdr.ar_tha, 0, ETHER_ADDR_LEN);                  // Set target's MAC address to zero (unknown)
-                arp_hdr.ar_tip = dest_ip;                                   // Set target IP address (the IP you're looking for)
-
-                // 1. Serialize Ethernet Header
-                Packet packet;
-                packet.resize(sizeof(ether_hdr));                           // Resize the vector to fit the Ethernet header
-                std::memcpy(packet.data(), &ether_hdr, sizeof(ether_hdr));  // Copy Ethernet header into the vector
-
-                // 2. Serialize ARP Header
-                packet.resize(packet.size() + sizeof(arp_hdr));                             // Resize the vector to accommodate the ARP header
-                std::memcpy(packet.data() + sizeof(ether_hdr), &arp_hdr, sizeof(arp_hdr));  // Copy ARP header after Ethernet header
-
-                // Debug: Print ARP response
-                print_hdrs((uint8_t*)packet.data(), sizeof(ether_hdr) + sizeof(arp_hdr));
-
-                // Proceed to resend the ARP request
-                packetSender->sendPacket(packet, iface);  // TODO: Need to check this iface
-
-                spdlog::info("ARP request send to dest_ip {}", dest_ip);
-
-                // Update the request's metadata
-                request.lastSent = std::chrono::steady_clock::now();
-                request.timesSent++;
+        else if (!request.queued) {
+            // Join the burst of the outgoing interface; flushBursts() sends it and updates the metadata
+            uint32_t nextHopIndex = routingTable->lookupNextHop(dest_ip);
+            if (nextHopIndex != NO_NEXT_HOP) {
+                interfaceArps[routingTable->getNextHop(nextHopIndex).iface].burst.push_back(dest_ip);
+                request.queued = true;
             }
             else {
-                // If no valid routing entry is found, handle it accordingly
-                std::cout << "Error: No valid routing entry for IP " << dest_ip << std::endl;
+                // Checked again every RETRY_INTERVAL until a route appears
+                spdlog::warn("No route for ARP request to IP {}.", dotted(dest_ip));
+                request.lastSent = std::chrono::steady_clock::now();
+                schedule(request.lastSent + RETRY_INTERVAL, dest_ip, Deadline::RequestRetry);
+            }
+        }
+    }
+}
+
+bool ArpCache::transmitArpRequest(ip_addr dest_ip, const mac_addr& target) {
+    uint32_t nextHopIndex = routingTable->lookupNextHop(dest_ip);
+    if (nextHopIndex == NO_NEXT_HOP) {
+        return false;
+    }
+
+    InterfaceId id = routingTable->getNextHop(nextHopIndex).iface;
+    InterfaceArp& arp = interfaceArps[id];
+    refreshTemplate(id, arp);
+    sendFromTemplate(arp, dest_ip, target);
+    return true;
+}
+
+void ArpCache::flushBursts(Clock::time_point now) {
+    for (auto& [id, arp] : interfaceArps) {
+        if (arp.burst.empty()) {
+            continue;
+        }
+        refreshTemplate(id, arp);
+
+        // Top up the budget for the time since the previous burst
+        double elapsed = std::chrono::duration<double>(now - arp.refilled).count();
+        arp.tokens = std::min(arp.tokens + elapsed * broadcastRate, broadcastBurst);
+        arp.refilled = now;
+
+        size_t sent = 0;
+        size_t next = 0;
+        for (; next < arp.burst.size() && arp.tokens >= 1; ++next) {
+            ip_addr ip = arp.burst[next];
+            auto it = requests.find(ip);
+            if (it == requests.end() || !it->second.queued) {
+                continue;  // Answered meanwhile, or listed twice
+            }
+
+            sendFromTemplate(arp, ip, std::nullopt);
+            arp.tokens -= 1;
+            sent++;
+
+            // Update the request's metadata; resend, or give up, once the interval has passed without a reply
+            PendingRequest& request = it->second;
+            request.queued = false;
+            request.timesSent++;
+            request.lastSent = now;
+            schedule(now + RETRY_INTERVAL, ip, Deadline::RequestRetry);
+        }
+        arp.burst.erase(arp.burst.begin(), arp.burst.begin() + next);
+
+        if (sent > 0) {
+            spdlog::info("Sent {} ARP requests on interface {}.", sent, arp.name);
+        }
+        if (!arp.burst.empty()) {
+            spdlog::info("{} ARP requests on interface {} wait for the broadcast budget.", arp.burst.size(), arp.name);
+
+            // Come back once the budget allows the next request
+            auto wait = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((1 - arp.tokens) / broadcastRate));
+            Clock::time_point when = now + wait;
+            if (pacingAt <= now || when < pacingAt) {
+                pacingAt = when;
+                schedule(when, 0, Deadline::BurstPacing);
             }
         }
     }
 }
 
+void ArpCache::refreshTemplate(InterfaceId id, InterfaceArp& arp) {
+    if (arp.name.empty()) {
+        arp.name = routingTable->getInterfaceName(id);
+    }
+    RoutingInterface interface = routingTable->getRoutingInterface(arp.name);
+    if (!arp.request.empty() && interface.ip == arp.ip && interface.mac == arp.mac) {
+        return;
+    }
+    arp.ip = interface.ip;
+    arp.mac = interface.mac;
+
+    // Ethernet header
+    struct sr_ethernet_hdr ether_hdr;
+    memset(&ether_hdr, 0, sizeof(ether_hdr));
+    memset(ether_hdr.ether_dhost, 0xFF, ETHER_ADDR_LEN);               // Set destination MAC to broadcast address
+    memcpy(ether_hdr.ether_shost, arp.mac.data(), ETHER_ADDR_LEN);     // Set source MAC address
+    ether_hdr.ether_type = htons(ethertype_arp);                       // Set EtherType to ARP (0x0806)
+
+    // ARP header
+    struct sr_arp_hdr arp_hdr;
+    memset(&arp_hdr, 0, sizeof(arp_hdr));
+    arp_hdr.ar_hrd = htons(arp_hrd_ethernet);                // Set hardware type to Ethernet (1)
+    arp_hdr.ar_pro = htons(0x0800);                          // Set protocol type to IPv4 (0x0800)
+    arp_hdr.ar_hln = 6;                                      // Set hardware address length (6 for MAC)
+    arp_hdr.ar_pln = 4;                                      // Set protocol address length (4 for IPv4)
+    arp_hdr.ar_op = htons(arp_op_request);                   // Set ARP operation to request (1)
+    memcpy(arp_hdr.ar_sha, arp.mac.data(), ETHER_ADDR_LEN);  // Set sender's MAC address (your MAC address)
+    arp_hdr.ar_sip = arp.ip;                                 // Set sender's IP address (your IP address)
+    memset(arp_hdr.ar_tha, 0, ETHER_ADDR_LEN);               // Set target's MAC address to zero (unknown)
+    arp_hdr.ar_tip = 0;                                      // Filled in for each request
+
+    // Serialize both headers
+    arp.request.resize(sizeof(ether_hdr) + sizeof(arp_hdr));
+    std::memcpy(arp.request.data(), &ether_hdr, sizeof(ether_hdr));
+    std::memcpy(arp.request.data() + sizeof(ether_hdr), &arp_hdr, sizeof(arp_hdr));
+
+    spdlog::info("Built ARP request template for interface {}.", arp.name);
+}
+
+void ArpCache::sendFromTemplate(const InterfaceArp& arp, ip_addr dest_ip, const std::optional<mac_addr>& target) {
+    Packet packet = arp.request;
+    auto* ethHeader = reinterpret_cast<sr_ethernet_hdr_t*>(packet.data());
+    auto* arpHeader = reinterpret_cast<sr_arp_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
+    arpHeader->ar_tip = dest_ip;  // Set target IP address (the IP you're looking for)
+    if (target) {
+        // Probe the known neighbor directly
+        std::memcpy(ethHeader->ether_dhost, target->data(), ETHER_ADDR_LEN);
+        std::memcpy(arpHeader->ar_tha, target->data(), ETHER_ADDR_LEN);
+    }
+    packetSender->sendPacket(std::move(packet), arp.name);
+}
+
 // UPDATE: This is a custom function
 /**
  * @brief Sends an ARP response to a given destination IP and MAC address.
@@ -134,9 +410,7 @@ void ArpCache::sendArpRequest(const uint32_t dest_ip) {
 void ArpCache::sendArpResponse(const uint32_t dest_ip, const mac_addr dest_mac, const std::string& source_iface) {
     spdlog::info("Sending ARP response on interface {} to ip {}.", source_iface, dest_ip);
     // Resend the ARP request and update the metadata
-    auto dest_routingEntryOpt = routingTable->getRoutingEntry(dest_ip);
-
-    if (dest_routingEntryOpt) {
+    if (routingTable->lookupNextHop(dest_ip) != NO_NEXT_HOP) {
         // If a valid routing entry is found, use its interface to send the ARP request
         RoutingInterface interface = routingTable->getRoutingInterface(source_iface);
         ip_addr source_ip = interface.ip;
@@ -179,7 +453,7 @@ void ArpCache::sendArpResponse(const uint32_t dest_ip, const mac_addr dest_mac,
     }
     else {
         // If no valid routing entry is found, handle it accordingly
-        std::cout << "Error: No valid routing entry for IP " << dest_ip << std::endl;
+        spdlog::error("No route for ARP response to IP {}.", dotted(dest_ip));
     }
 }
 
@@ -187,17 +461,7 @@ void ArpCache::tick() {
     // DO NOT CHANGE THIS
     std::unique_lock lock(mutex);
 
-    // Loop through the requests and resend not-replied requests
-    for (auto& [dest_ip, request] : requests) {
-        // Resend the ARP request
-        spdlog::info("Ticking to send ARP request to dest_ip {}", dest_ip);
-        sendArpRequest(dest_ip);
-    }
-
-    // DO NOT CHANGE THIS
-    std::erase_if(entries, [this](const auto& entry) {
-        return std::chrono::steady_clock::now() - entry.second.timeAdded >= timeout;
-    });
+    runExpired(Clock::now());
 }
 
 void ArpCache::addEntry(uint32_t ip, const mac_addr& mac) {
@@ -205,97 +469,243 @@ void ArpCache::addEntry(uint32_t ip, const mac_addr& mac) {
     std::unique_lock lock(mutex);
 
     spdlog::info("Adding IP {} to Arp Cache", ip);
-    // Check if there are any pending ARP requests for this IP
+
+    // Send the packets that waited for the neighbor before publishing it, so a worker
+    // that finds the entry cannot send a later packet of a flow ahead of them
     auto it = requests.find(ip);
     if (it != requests.end()) {
-        // Create or update the ARP entry for the given IP
-        ArpEntry entry = {ip, mac, std::chrono::steady_clock::now()};
-
-        // Insert or update the entry in the ARP cache
-        entries[ip] = entry;
-
-        // If there are pending requests, resend the awaiting packets
-        for (const auto& awaitingPacket : it->second.awaitingPackets) {
-            // Get Source mac
-            std::string dest_iface = routingTable->getRoutingEntry(ip)->iface;
+        uint32_t nextHopIndex = routingTable->lookupNextHop(ip);
+        if (nextHopIndex == NO_NEXT_HOP) {
+            spdlog::error("No route to resolved IP {}. Dropping queued packets.", ip);
+        }
+        else {
+            const std::string& dest_iface = routingTable->getInterfaceName(routingTable->getNextHop(nextHopIndex).iface);
             auto source_mac = routingTable->getRoutingInterface(dest_iface).mac;
 
-            // Modify the Ethernet header
-            auto* ethHeader = const_cast<sr_ethernet_hdr_t*>(
-                reinterpret_cast<const sr_ethernet_hdr_t*>(awaitingPacket.packet.data()));
-            std::memcpy(ethHeader->ether_shost, source_mac.data(), ETHER_ADDR_LEN);  // Set source MAC address
-            std::memcpy(ethHeader->ether_dhost, mac.data(), ETHER_ADDR_LEN);         // Set dest MAC address
-
-            // Update IP Header
-            auto* ipHeader = const_cast<sr_ip_hdr_t*>(reinterpret_cast<const sr_ip_hdr_t*>(awaitingPacket.packet.data() + sizeof(sr_ethernet_hdr_t)));
-            ipHeader->ip_ttl--;                                     // Decrement TTL by 1;
-            ipHeader->ip_sum = 0;                                   // Reset checksum before recalculating
-            ipHeader->ip_sum = cksum(ipHeader, sizeof(sr_ip_hdr));  // Recompute the checksum
-
-            // Debug: Print queued packet
-            spdlog::info("Resending queued packets to interface {}", dest_iface);
-            print_hdrs((uint8_t*)awaitingPacket.packet.data(), sizeof(sr_ethernet_hdr) + sizeof(sr_ip_hdr) + sizeof(sr_icmp_hdr));
-            packetSender->sendPacket(awaitingPacket.packet, dest_iface);
+            pendingPackets.drain(it->second.packets, [&](Packet& packet, const std::string&) {
+                spdlog::info("Resending queued packets to interface {}", dest_iface);
+                sendHeldPacket(std::move(packet), mac, source_mac, dest_iface);
+            });
         }
 
         // After processing the awaiting packets, remove the request from the requests map
-        requests.erase(it);
-    }
-    else {
-        std::cout << "Error: This should not happen" << std::endl;
-        return;
+        eraseRequest(it);
     }
-}
 
-std::optional<mac_addr> ArpCache::getEntry(uint32_t dest_ip) {
-    // DO NOT CHANGE THIS
-    std::unique_lock lock(mutex);
+    // Insert or update the entry in the ARP cache; a reply confirms the neighbor whatever its state
+    Clock::time_point now = Clock::now();
+    neighbors.insert(ip, mac, stampOf(now), toNote({NeighborState::Reachable}));
+    unreachable.erase(ip);
+    schedule(now + refreshAfter(), ip, Deadline::NeighborCheck);
+}
 
-    // Check if the IP exists in the ARP cache
-    auto it = entries.find(dest_ip);
-    if (it != entries.end()) {
-        return it->second.mac;  // Return the MAC address if found
+void ArpCache::sendHeldPacket(Packet&& packet, const mac_addr& mac, const mac_addr& source_mac, const std::string& dest_iface) {
+    // Same rewrite and checks as frames forwarded on an ARP hit
+    if (rewrite_for_next_hop(packet, source_mac, mac)) {
+        packetSender->sendPacket(std::move(packet), dest_iface);
     }
+}
 
-    return std::nullopt;  // Return nullopt if not found
+std::optional<mac_addr> ArpCache::getEntry(uint32_t dest_ip) {
+    // Lock-free: the neighbor table is readable while the ARP thread holds the mutex
+    return neighbors.find(dest_ip);
 }
 
 void ArpCache::queuePacket(uint32_t dest_ip, const Packet& packet, const std::string& src_iface) {
+    queuePacket(dest_ip, Packet(packet), src_iface);
+}
+
+void ArpCache::queuePacket(uint32_t dest_ip, Packet&& packet, const std::string& src_iface) {
     spdlog::info("Queuing packet for dest_ip {}.", dest_ip);
 
     // DO NOT CHANGE THIS
     std::unique_lock lock(mutex);
 
-    // Check if there is already an existing ARP request for this IP
-    auto it = requests.find(dest_ip);
-    if (it != requests.end()) {
-        // If an ARP request already exists, add the packet to the awaitingPackets list
-        spdlog::info("ARP request already exists. Pushing back");
-        it->second.awaitingPackets.push_back({packet, src_iface});
+    // The caller missed the neighbor without the mutex; it may have been added since
+    if (std::optional<mac_addr> mac = neighbors.find(dest_ip)) {
+        uint32_t nextHopIndex = routingTable->lookupNextHop(dest_ip);
+        if (nextHopIndex == NO_NEXT_HOP) {
+            spdlog::error("No route to resolved IP {}. Dropping packet.", dest_ip);
+            return;
+        }
+        const std::string& dest_iface = routingTable->getInterfaceName(routingTable->getNextHop(nextHopIndex).iface);
+        spdlog::info("IP {} was resolved meanwhile. Sending packet right away.", dest_ip);
+        sendHeldPacket(std::move(packet), *mac, routingTable->getRoutingInterface(dest_iface).mac, dest_iface);
+        return;
+    }
+
+    if (rejectUnreachable(dest_ip, packet, src_iface, Clock::now())) {
+        return;
     }
-    else {
-        // If no ARP request exists for this IP, create a new one
-        ArpRequest newRequest;
-        newRequest.ip = dest_ip;
-        newRequest.awaitingPackets.push_back({packet, src_iface});
-        newRequest.timesSent = 0;
 
-        // Add the new request to the requests map
-        requests[dest_ip] = newRequest;
+    // Check if there is already an existing ARP request for this IP
+    auto [it, created] = requests.try_emplace(dest_ip);
+    if (!pendingPackets.push(it->second.packets, packet, src_iface)) {
+        spdlog::warn("ARP queue for IP {} is full. Dropping packet.", dest_ip);
+    }
 
-        // Send the ARP request since it is the first time
+    if (created) {
+        // Send the ARP request since it is the first time, even if the packet was dropped
         spdlog::info("Creating new ARP request since it doesn't exist");
         sendArpRequest(dest_ip);
+        flushBursts(Clock::now());
+    }
+}
+
+void ArpCache::resolveGateways(const std::vector<ip_addr>& gateways) {
+    std::unique_lock lock(mutex);
+
+    spdlog::info("Resolving {} gateways ahead of traffic.", gateways.size());
+    pinned = std::unordered_set<ip_addr>(gateways.begin(), gateways.end());
+    for (ip_addr gateway : gateways) {
+        resolve(gateway);
+    }
+    flushBursts(Clock::now());
+}
+
+void ArpCache::learnNeighbor(ip_addr ip, const mac_addr& mac, const std::string& iface) {
+    // Broadcast and multicast addresses have the group bit set
+    if (!learnNeighbors || ip == 0 || (mac[0] & 0x01)) {
+        return;
+    }
+
+    // Only trust senders that belong on the link the packet came from
+    uint32_t nextHopIndex = routingTable->lookupNextHop(ip);
+    if (nextHopIndex == NO_NEXT_HOP ||
+        routingTable->getInterfaceName(routingTable->getNextHop(nextHopIndex).iface) != iface) {
+        spdlog::info("Not learning neighbor {} from interface {}: it is not routed there.", ntohl(ip), iface);
+        return;
+    }
+    for (const auto& [name, interface] : routingTable->getRoutingInterfaces()) {
+        if (interface.ip == ip) {
+            spdlog::warn("Not learning neighbor {} from interface {}: it claims our address.", ntohl(ip), iface);
+            return;
+        }
+    }
+
+    spdlog::info("Learned neighbor {} from interface {}.", ntohl(ip), iface);
+    addEntry(ip, mac);
+}
+
+size_t ArpCache::restoreSnapshot() {
+    if (snapshotPath.empty() || !std::filesystem::exists(snapshotPath)) {
+        return 0;
+    }
+
+    NeighborSnapshotContents contents;
+    try {
+        contents = readNeighborSnapshot(snapshotPath);
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to restore ARP cache: {}", e.what());
+        return 0;
+    }
+    auto age = std::chrono::system_clock::now() - contents.savedAt;
+    if (age > SNAPSHOT_MAX_AGE) {
+        spdlog::info("ARP cache snapshot {} is {} s old. Not restoring it.", snapshotPath.string(),
+                     std::chrono::duration_cast<std::chrono::seconds>(age).count());
+        return 0;
+    }
+
+    std::unique_lock lock(mutex);
+
+    Clock::time_point now = Clock::now();
+    size_t restored = 0;
+    for (const NeighborRecord& record : contents.neighbors) {
+        if (record.ip == 0 || neighbors.stampOf(record.ip)) {
+            continue;
+        }
+        neighbors.insert(record.ip, record.mac, stampOf(now), toNote({NeighborState::Probe}));
+
+        // Spread the confirmations out like broadcasts, so a large table does not flood the LAN
+        auto delay = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(restored / broadcastRate));
+        schedule(now + delay, record.ip, Deadline::NeighborCheck);
+        restored++;
+    }
+
+    spdlog::info("Restored {} neighbors from {}.", restored, snapshotPath.string());
+    return restored;
+}
+
+std::vector<NeighborRecord> ArpCache::snapshotRecords() const {
+    std::vector<NeighborRecord> records;
+    records.reserve(neighbors.size());
+    neighbors.forEach([&](ip_addr ip, const mac_addr& mac) { records.push_back({ip, mac}); });
+    return records;
+}
+
+void ArpCache::saveSnapshot(const std::vector<NeighborRecord>& records) {
+    try {
+        writeNeighborSnapshot(snapshotPath, records);
+        spdlog::info("Saved {} neighbors to {}.", records.size(), snapshotPath.string());
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to save ARP cache: {}", e.what());
+    }
+}
+
+PendingPacketStats ArpCache::pendingStats() {
+    std::unique_lock lock(mutex);
+    return pendingPackets.stats();
+}
+
+uint64_t ArpCache::neighborEvictions() {
+    std::unique_lock lock(mutex);
+    return neighbors.evictions();
+}
+
+void ArpCache::holdDownNextHop(ip_addr ip, Clock::time_point now) {
+    if (holdDown.count() == 0) {
+        // No HoldDownExpiry will come to resolve a pinned gateway again
+        if (pinned.contains(ip)) {
+            schedule(now + RETRY_INTERVAL, ip, Deadline::GatewayRetry);
+        }
+        return;
+    }
+    spdlog::info("Holding down next hop {} for {} ms.", ntohl(ip), holdDown.count());
+
+    // The failed request has just answered every packet it held
+    unreachable[ip] = {now + holdDown, now};
+    schedule(now + holdDown, ip, Deadline::HoldDownExpiry);
+}
+
+bool ArpCache::rejectUnreachable(ip_addr ip, const Packet& packet, const std::string& iface, Clock::time_point now) {
+    auto it = unreachable.find(ip);
+    if (it == unreachable.end() || it->second.until <= now) {
+        return false;
+    }
+
+    if (now - it->second.lastIcmp < UNREACHABLE_ICMP_INTERVAL) {
+        spdlog::debug("Next hop {} is held down. Dropping packet.", ntohl(ip));
+        return true;
     }
+    it->second.lastIcmp = now;
+
+    const auto* ethernetHeader = reinterpret_cast<const sr_ethernet_hdr_t*>(packet.data());
+    const auto* ipHeader = reinterpret_cast<const sr_ip_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
+    sendICMPHostUnreachable(ipHeader, ethernetHeader, iface);
+    return true;
+}
+
+void ArpCache::eraseRequest(std::unordered_map<ip_addr, PendingRequest>::iterator request) {
+    pendingPackets.release(request->second.packets);
+    requests.erase(request);
 }
 
 // Checks if the request has been sent and is waiting for a response
 bool ArpCache::requestExists(uint32_t dest_ip) {
+    std::unique_lock lock(mutex);
+
     auto it = requests.find(dest_ip);
     if (it != requests.end()) {
         return true;
     }
-    return false;
+
+    // A late reply to the failed request ends the hold-down
+    auto held = unreachable.find(dest_ip);
+    if (held != unreachable.end() && held->second.until > Clock::now()) {
+        return true;
+    }
+    std::optional<NeighborStatus> status = statusOf(dest_ip);
+    return status && status->state == NeighborState::Probe;
 }
 
 void ArpCache::sendICMPHostUnreachable(const sr_ip_hdr_t* ipHeader, const sr_ethernet_hdr_t* originalEthHeader, const std::string& iface) {
@@ -387,30 +797,26 @@ void ArpCache::sendICMPHostUnreachable(const sr_ip_hdr_t* ipHeader, const sr_eth
     spdlog::info("ICMP Destination Host Unreachable message sent.");
 }
 
-void ArpCache::handleFailedArpRequest(ArpRequest& arpRequest) {
+void ArpCache::handleFailedArpRequest(ip_addr ip) {
+    PendingRequest& request = requests.at(ip);
     spdlog::warn("ARP request for IP {} failed after {} attempts. Sending ICMP Host Unreachable messages.",
-                 ntohl(arpRequest.ip), arpRequest.timesSent);
+                 ntohl(ip), request.timesSent);
 
-    for (const auto& awaitingPacket : arpRequest.awaitingPackets) {
+    pendingPackets.drain(request.packets, [&](const Packet& packet, const std::string& iface) {
         // Extract headers from the awaiting packet
-        if (awaitingPacket.packet.empty()) {
+        if (packet.empty()) {
             spdlog::warn("Encountered an empty packet while processing awaiting ARP packets.");
-            continue;
+            return;
         }
 
-        const auto* ethernetHeader = const_cast<sr_ethernet_hdr_t*>(reinterpret_cast<const sr_ethernet_hdr_t*>(awaitingPacket.packet.data()));
-        const auto* ipHeader = reinterpret_cast<const sr_ip_hdr_t*>(awaitingPacket.packet.data() + sizeof(sr_ethernet_hdr_t));
-
-        if (!ethernetHeader || !ipHeader) {
-            spdlog::error("Malformed packet in ARP request queue for IP {}. Skipping.", ntohl(arpRequest.ip));
-            continue;
-        }
+        const auto* ethernetHeader = reinterpret_cast<const sr_ethernet_hdr_t*>(packet.data());
+        const auto* ipHeader = reinterpret_cast<const sr_ip_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
 
-        spdlog::debug("Processing awaiting packet for IP {} on interface {}.", ntohl(arpRequest.ip), awaitingPacket.iface);
+        spdlog::debug("Processing awaiting packet for IP {} on interface {}.", ntohl(ip), iface);
 
         // Send ICMP Host Unreachable for this packet
-        sendICMPHostUnreachable(ipHeader, ethernetHeader, awaitingPacket.iface);
-    }
+        sendICMPHostUnreachable(ipHeader, ethernetHeader, iface);
+    });
 
-    spdlog::info("Completed sending ICMP Host Unreachable messages for ARP request failure (IP {}).", ntohl(arpRequest.ip));
+    spdlog::info("Completed sending ICMP Host Unreachable messages for ARP request failure (IP {}).", ntohl(ip));
 }
\ No newline at end of file
@@ -2,27 +2,115 @@
 #define ARPCACHE_H
 
 #include <array>
+#include <bit>
 #include <chrono>
+#include <condition_variable>
+#include <filesystem>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <queue>
 #include <set>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "IArpCache.h"
 #include "IPacketSender.h"
 #include "IRoutingTable.h"
+#include "NeighborSnapshot.h"
+#include "NeighborTable.h"
+#include "PendingPacketPool.h"
 #include "RouterTypes.h"
 
+/**
+ * @struct ArpCacheOptions
+ * @brief Sizing and timing of the ARP cache.
+ */
+struct ArpCacheOptions {
+    size_t capacity = NeighborTable::DEFAULT_CAPACITY; /**< Neighbor table slots, a power of two. */
+    PendingPacketLimits pending;                       /**< Caps on packets waiting for resolution. */
+    std::chrono::milliseconds holdDown{5000};          /**< How long a failed next hop stays unreachable; zero disables. */
+    bool resolveGateways = false;                      /**< Resolve every routing table gateway ahead of traffic. */
+    double broadcastRate = 200;                        /**< Broadcast requests per second and interface. */
+    size_t broadcastBurst = 64;                        /**< Broadcast requests an idle interface may send at once. */
+    std::filesystem::path snapshotPath;                /**< Where neighbors are saved across restarts; empty disables. */
+    std::chrono::milliseconds snapshotInterval{60000}; /**< Time between two saves. */
+    bool learnNeighbors = false;                       /**< Learn senders of requests to us and of gratuitous ARP. */
+};
+
+/**
+ * @class ArpCache
+ * @brief ARP cache and request queue, timed by a min-heap of deadlines.
+ *
+ * Every request retry and every entry expiry pushes its deadline onto the heap. The
+ * background thread sleeps until the earliest deadline (or until an earlier one is
+ * pushed) and then only handles the deadlines that are due, so an idle cache costs
+ * nothing and a wakeup costs O(log n) per expired item. Deadlines are never removed
+ * when a request is answered or an entry is refreshed; a deadline that no longer
+ * matches the current state is recognized and skipped when it comes due.
+ *
+ * Resolved addresses live in a NeighborTable together with the time they were
+ * resolved, so getEntry() never takes the mutex and forwarding threads never wait for
+ * the ARP thread. When the table is full, the least recently used neighbors are evicted.
+ *
+ * A neighbor is REACHABLE for the timeout after a reply confirmed it. Shortly before
+ * that runs out, a neighbor that was used since it was confirmed enters PROBE and is
+ * sent unicast requests to its known MAC address; one that was not becomes STALE and
+ * is removed at the timeout unless it gets used by then. Forwarding keeps using the
+ * known MAC address in every state, so hot next hops never fall back to queuing. A
+ * neighbor that does not answer any probe is removed.
+ *
+ * Packets waiting for a neighbor are moved into bounded queues in a preallocated
+ * PendingPacketPool; bursts towards an unresolved next hop are dropped according to
+ * the configured caps and policy instead of growing memory.
+ *
+ * A next hop that did not answer any request is held down as unreachable for a while.
+ * Packets towards it are answered with ICMP host unreachable right away, at most once
+ * per UNREACHABLE_ICMP_INTERVAL, and dropped instead of starting another request. A
+ * reply from the next hop ends the hold-down early.
+ *
+ * Broadcast requests are not sent one by one. Every request that comes due while the
+ * deadlines are handled joins the burst of its outgoing interface, and each burst is
+ * then sent from a request frame prebuilt for the interface, of which only the target
+ * address changes. A token bucket per interface paces the bursts: requests beyond the
+ * broadcast budget wait for it, so scanning thousands of unresolved hosts cannot flood
+ * a LAN. Retries only count requests that were actually sent.
+ *
+ * With a snapshot path, the neighbors are saved to it periodically and when the cache
+ * is destroyed. restoreSnapshot() brings them back in PROBE: they are used right away
+ * and confirmed in the background, at the broadcast rate.
+ *
+ * Gateways passed to resolveGateways() are resolved before any packet needs them and are
+ * treated as always in use: they are probed instead of going stale, and resolved again
+ * after a failed probe or when their hold-down ends. Without hold-down, a gateway whose
+ * request failed is resolved again after RETRY_INTERVAL.
+ */
 class ArpCache : public IArpCache {
    public:
+    /** Time between two ARP requests for the same address. */
+    static constexpr std::chrono::milliseconds RETRY_INTERVAL{1000};
+
+    /** Unicast requests sent to a neighbor in PROBE before it is given up. */
+    static constexpr uint32_t MAX_PROBES = 3;
+
+    /** Minimum time between two ICMP host unreachable for the same held-down next hop. */
+    static constexpr std::chrono::milliseconds UNREACHABLE_ICMP_INTERVAL{100};
+
+    /** Snapshots saved longer ago than this are not restored. */
+    static constexpr std::chrono::minutes SNAPSHOT_MAX_AGE{5};
+
     ArpCache(std::chrono::milliseconds timeout,
-             std::shared_ptr<IPacketSender> packetSender, std::shared_ptr<IRoutingTable> routingTable);
+             std::shared_ptr<IPacketSender> packetSender, std::shared_ptr<IRoutingTable> routingTable,
+             ArpCacheOptions options = {});
 
     ~ArpCache() override;
 
+    /**
+     * @brief Handles every deadline that is due: resends or fails requests and removes
+     * expired entries.
+     */
     void tick();
 
     void addEntry(uint32_t ip, const mac_addr& mac) override;
@@ -31,26 +119,244 @@ class ArpCache : public IArpCache {
 
     void queuePacket(uint32_t ip, const Packet& packet, const std::string& iface) override;
 
+    void queuePacket(uint32_t ip, Packet&& packet, const std::string& iface) override;
+
+    /**
+     * @brief Resolves the given gateways and keeps them resolved, replacing the gateways
+     * of the previous call.
+     *
+     * Gateways that are already resolved, being resolved or held down are left alone.
+     */
+    void resolveGateways(const std::vector<ip_addr>& gateways);
+
+    /**
+     * @brief Learns a neighbor from an ARP packet it did not send in reply to us: a
+     * request for one of our addresses or a gratuitous announcement.
+     *
+     * Does nothing unless learnNeighbors is enabled, or if the sender is not a unicast
+     * host that the routing table places behind the interface the packet came in on.
+     */
+    void learnNeighbor(ip_addr ip, const mac_addr& mac, const std::string& iface);
+
+    /**
+     * @brief Adds the neighbors of the snapshot file, if one is configured and recent,
+     * and starts confirming them. Needs the interfaces to be known for the probes.
+     * @return The number of neighbors restored.
+     */
+    size_t restoreSnapshot();
+
+    /**
+     * @brief Returns the number of queued packets and the drop counters.
+     */
+    PendingPacketStats pendingStats();
+
+    /**
+     * @brief Returns the number of neighbors evicted from the full neighbor table so far.
+     */
+    uint64_t neighborEvictions();
+
     void sendArpRequest(const uint32_t);
     void sendArpResponse(const uint32_t, const mac_addr, const std::string&);
+    /**
+     * @brief Returns whether a reply from the address is expected: it is being resolved,
+     * probed or held down.
+     */
     bool requestExists(uint32_t dest_ip);
-    void handleFailedArpRequest(ArpRequest& arpRequest);
+    void handleFailedArpRequest(ip_addr ip);
     void sendICMPHostUnreachable(const sr_ip_hdr_t* ipHeader, const sr_ethernet_hdr_t* originalEthHeader, const std::string& iface);
 
    private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct PendingRequest
+     * @brief An unanswered ARP request and the packets waiting for its reply.
+     */
+    struct PendingRequest {
+        Clock::time_point lastSent;
+        uint32_t timesSent = 0;
+        bool queued = false; /**< Waiting in the burst of its interface. */
+        PendingPacketPool::Queue packets;
+    };
+
+    /**
+     * @struct InterfaceArp
+     * @brief Request template, pending burst and broadcast budget of an interface.
+     */
+    struct InterfaceArp {
+        std::string name;
+        ip_addr ip = 0;             /**< Address the template was built for. */
+        mac_addr mac{};             /**< Likewise. */
+        Packet request;             /**< Broadcast request from the interface, without a target. */
+        std::vector<ip_addr> burst; /**< Addresses whose broadcast request is due, oldest first. */
+        double tokens = 0;          /**< Broadcast budget left. */
+        Clock::time_point refilled; /**< When tokens was last topped up. */
+    };
+
+    /**
+     * @enum NeighborState
+     * @brief Reachability of a resolved neighbor.
+     */
+    enum class NeighborState : uint8_t {
+        Reachable, /**< Confirmed within the timeout. */
+        Stale,     /**< Not used lately; removed at the timeout unless used by then. */
+        Probe      /**< Being reconfirmed with unicast requests. */
+    };
+
+    /**
+     * @struct NeighborStatus
+     * @brief Reachability bookkeeping of a neighbor, stored as the note of its
+     * NeighborTable entry. All zero is a REACHABLE neighbor.
+     */
+    struct NeighborStatus {
+        NeighborState state = NeighborState::Reachable;
+        uint8_t probesSent = 0;
+        uint16_t reserved = 0;
+        uint32_t lastProbe = 0; /**< Stamp of the last probe. */
+    };
+    static_assert(sizeof(NeighborStatus) == sizeof(uint64_t));
+
+    /**
+     * @struct Unreachable
+     * @brief A next hop that did not answer, held down until a point in time.
+     */
+    struct Unreachable {
+        Clock::time_point until;
+        Clock::time_point lastIcmp; /**< Last ICMP host unreachable sent for the next hop. */
+    };
+
+    /**
+     * @struct Deadline
+     * @brief A point in time at which a request or an entry has to be looked at again.
+     */
+    struct Deadline {
+        enum Kind { RequestRetry, NeighborCheck, HoldDownExpiry, GatewayRetry, BurstPacing, SnapshotSave };
+
+        Clock::time_point when;
+        ip_addr ip;
+        Kind kind;
+
+        bool operator>(const Deadline& other) const { return when > other.when; }
+    };
+
     void loop();
 
+    /**
+     * @brief Handles the deadlines that are due at the given time. Requires mutex.
+     */
+    void runExpired(Clock::time_point now);
+
+    /**
+     * @brief Adds a deadline, waking the thread if it is now the earliest. Requires mutex.
+     */
+    void schedule(Clock::time_point when, ip_addr ip, Deadline::Kind kind);
+
+    /** @brief Milliseconds since the cache was created, as stored in the neighbor table. */
+    uint32_t stampOf(Clock::time_point time) const;
+
+    /** @brief Time after a confirmation at which a neighbor in use is probed. */
+    std::chrono::milliseconds refreshAfter() const;
+
+    /**
+     * @brief Moves a neighbor along its state machine once its deadline is due. Requires mutex.
+     */
+    void checkNeighbor(ip_addr ip, Clock::time_point now);
+
+    /** @brief Sends the next unicast request to a neighbor in PROBE. Requires mutex. */
+    void sendProbe(ip_addr ip, NeighborStatus& status, Clock::time_point now);
+
+    /** @brief Returns the status of a resolved neighbor. Requires mutex. */
+    std::optional<NeighborStatus> statusOf(ip_addr ip) const;
+
+    static uint64_t toNote(const NeighborStatus& status) { return std::bit_cast<uint64_t>(status); }
+
+    /** @brief Removes a neighbor and its status. Requires mutex. */
+    void eraseNeighbor(ip_addr ip);
+
+    /**
+     * @brief Starts a request for an address that is neither resolved, being resolved
+     * nor held down. Requires mutex.
+     */
+    void resolve(ip_addr ip);
+
+    /**
+     * @brief Sends an ARP request for an address to a known MAC address right away,
+     * outside of the bursts and the broadcast budget.
+     * @return False if there is no route to the address.
+     */
+    bool transmitArpRequest(ip_addr dest_ip, const mac_addr& target);
+
+    /**
+     * @brief Sends the burst of every interface as far as its broadcast budget allows,
+     * and schedules a wakeup for the rest. Requires mutex.
+     */
+    void flushBursts(Clock::time_point now);
+
+    /** @brief Rebuilds the request template if the interface address changed. Requires mutex. */
+    void refreshTemplate(InterfaceId id, InterfaceArp& arp);
+
+    /** @brief Sends the template of an interface for the given target. Requires mutex. */
+    void sendFromTemplate(const InterfaceArp& arp, ip_addr dest_ip, const std::optional<mac_addr>& target);
+
+    /**
+     * @brief Starts the hold-down of a next hop whose request failed, and schedules the
+     * next attempt if it is a pinned gateway. Requires mutex.
+     */
+    void holdDownNextHop(ip_addr ip, Clock::time_point now);
+
+    /**
+     * @brief Answers a packet towards a held-down next hop, subject to the ICMP rate
+     * limit. Requires mutex.
+     * @return False if the next hop is not held down and the packet has to be queued.
+     */
+    bool rejectUnreachable(ip_addr ip, const Packet& packet, const std::string& iface, Clock::time_point now);
+
+    /** @brief Lists the resolved neighbors for a snapshot. Requires mutex. */
+    std::vector<NeighborRecord> snapshotRecords() const;
+
+    /** @brief Writes a snapshot, logging failures. Does not need the mutex. */
+    void saveSnapshot(const std::vector<NeighborRecord>& records);
+
+    /**
+     * @brief Rewrites a packet that waited for a neighbor for its MAC address and sends
+     * it, or drops it if its IP length does not fit. Requires mutex, so that it cannot overtake packets drained by addEntry().
+     */
+    void sendHeldPacket(Packet&& packet, const mac_addr& mac, const mac_addr& source_mac, const std::string& dest_iface);
+
+    /** @brief Forgets a request and frees its queued packets. Requires mutex. */
+    void eraseRequest(std::unordered_map<ip_addr, PendingRequest>::iterator request);
+
     std::chrono::milliseconds timeout;
+    std::chrono::milliseconds holdDown;
+    double broadcastRate;
+    double broadcastBurst;
+    std::filesystem::path snapshotPath;
+    std::chrono::milliseconds snapshotInterval;
+    bool learnNeighbors;
+    Clock::time_point epoch; /**< Origin of the neighbor table stamps. */
 
     std::mutex mutex;
+    std::condition_variable wakeup; /**< Signalled when the earliest deadline changes or on shutdown. */
     std::unique_ptr<std::thread> thread;
     std::atomic<bool> shutdown = false;
 
     std::shared_ptr<IPacketSender> packetSender;
     std::shared_ptr<IRoutingTable> routingTable;
 
-    std::unordered_map<ip_addr, ArpEntry> entries;
-    std::unordered_map<ip_addr, ArpRequest> requests;
+    /**
+     * Resolved neighbors, stamped with their confirmation time and noted with their
+     * NeighborStatus. Written under mutex.
+     */
+    NeighborTable neighbors;
+    std::unordered_map<ip_addr, PendingRequest> requests;
+    PendingPacketPool pendingPackets; /**< Holds the packets of every request. */
+    std::unordered_map<ip_addr, Unreachable> unreachable; /**< Next hops in hold-down. */
+    std::unordered_set<ip_addr> pinned; /**< Gateways kept resolved regardless of traffic. */
+    std::unordered_map<InterfaceId, InterfaceArp> interfaceArps;
+    Clock::time_point pacingAt; /**< Latest BurstPacing deadline scheduled. */
+    bool snapshotDue = false;   /**< Set when a save is due; the thread writes it without the mutex. */
+
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<>> deadlines;
 };
 
 #endif  // ARPCACHE_H
@@ -0,0 +1,217 @@
+#include "Checksum.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHECKSUM_X86 1
+#endif
+
+namespace checksum {
+
+namespace {
+
+/** Below this length the vector kernels cost more to set up than they save. */
+constexpr size_t VECTOR_MIN_LEN = 256;
+
+/** Steps per block of the vector kernels. Each 32-bit lane gains at most 4 * 0xFFFF per step. */
+constexpr size_t BLOCK_STEPS = 8192;
+
+/** Headers whose memory is prefetched together by verifyIpHeaders(). */
+constexpr size_t VERIFY_GROUP = 16;
+
+uint64_t load64(const uint8_t* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint32_t load32(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Adds with end-around carry, which keeps the sum congruent modulo 0xFFFF
+uint64_t addCarry(uint64_t sum, uint64_t value) {
+    sum += value;
+    return sum + (sum < value);
+}
+
+// Folds a sum of native-order words to 16 bits and swaps it to host order
+uint16_t fold(uint64_t sum) {
+    sum = (sum >> 32) + (sum & 0xFFFFFFFF);
+    sum = (sum >> 32) + (sum & 0xFFFFFFFF);
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    return ntohs(static_cast<uint16_t>(sum));
+}
+
+uint64_t sumScalar(const uint8_t* data, size_t len) {
+    uint64_t sum = 0;
+    for (; len >= 32; data += 32, len -= 32) {
+        sum = addCarry(sum, load64(data));
+        sum = addCarry(sum, load64(data + 8));
+        sum = addCarry(sum, load64(data + 16));
+        sum = addCarry(sum, load64(data + 24));
+    }
+    for (; len >= 8; data += 8, len -= 8) {
+        sum = addCarry(sum, load64(data));
+    }
+    if (len >= 4) {
+        sum = addCarry(sum, load32(data));
+        data += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        uint16_t word;
+        std::memcpy(&word, data, sizeof(word));
+        sum = addCarry(sum, word);
+        data += 2;
+        len -= 2;
+    }
+    // A trailing odd byte is padded with a zero byte, as the first byte of a word
+    uint16_t word = 0;
+    std::memcpy(&word, data, len);
+    return addCarry(sum, word);
+}
+
+#ifdef CHECKSUM_X86
+uint64_t sumSse2(const uint8_t* data, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+    while (len >= 32) {
+        size_t steps = std::min(len / 32, BLOCK_STEPS);
+        __m128i acc = zero, acc2 = zero;
+        for (size_t i = 0; i < steps; ++i, data += 32) {
+            __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            __m128i words2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(words, zero));
+            acc2 = _mm_add_epi32(acc2, _mm_unpackhi_epi16(words, zero));
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(words2, zero));
+            acc2 = _mm_add_epi32(acc2, _mm_unpackhi_epi16(words2, zero));
+        }
+        len -= steps * 32;
+        acc = _mm_add_epi32(acc, acc2);
+
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        sum += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    return addCarry(sum, sumScalar(data, len));
+}
+
+__attribute__((target("avx2"))) uint64_t sumAvx2(const uint8_t* data, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+    while (len >= 64) {
+        size_t steps = std::min(len / 64, BLOCK_STEPS);
+        __m256i acc = zero, acc2 = zero;
+        for (size_t i = 0; i < steps; ++i, data += 64) {
+            __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            __m256i words2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(words, zero));
+            acc2 = _mm256_add_epi32(acc2, _mm256_unpackhi_epi16(words, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(words2, zero));
+            acc2 = _mm256_add_epi32(acc2, _mm256_unpackhi_epi16(words2, zero));
+        }
+        len -= steps * 64;
+        acc = _mm256_add_epi32(acc, acc2);
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        for (uint32_t lane : lanes) {
+            sum += lane;
+        }
+    }
+    return addCarry(sum, sumScalar(data, len));
+}
+#endif
+
+uint64_t sumWith(Kernel kernel, const uint8_t* data, size_t len) {
+    switch (kernel) {
+#ifdef CHECKSUM_X86
+        case Kernel::Sse2:
+            return sumSse2(data, len);
+        case Kernel::Avx2:
+            return sumAvx2(data, len);
+#endif
+        default:
+            return sumScalar(data, len);
+    }
+}
+
+}  // namespace
+
+bool isSupported(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Scalar:
+            return true;
+#ifdef CHECKSUM_X86
+        case Kernel::Sse2:
+            return __builtin_cpu_supports("sse2");
+        case Kernel::Avx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+Kernel activeKernel() {
+    static const Kernel kernel = isSupported(Kernel::Avx2)   ? Kernel::Avx2
+                                 : isSupported(Kernel::Sse2) ? Kernel::Sse2
+                                                             : Kernel::Scalar;
+    return kernel;
+}
+
+const char* kernelName(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Scalar:
+            return "scalar";
+        case Kernel::Sse2:
+            return "sse2";
+        case Kernel::Avx2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+uint16_t sum(const void* data, size_t len) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    if (len < VECTOR_MIN_LEN) {
+        return fold(sumScalar(bytes, len));
+    }
+    return fold(sumWith(activeKernel(), bytes, len));
+}
+
+uint16_t sum(Kernel kernel, const void* data, size_t len) {
+    return fold(sumWith(kernel, static_cast<const uint8_t*>(data), len));
+}
+
+size_t verifyIpHeaders(std::span<const sr_ip_hdr_t* const> headers, std::span<bool> valid) {
+    size_t validCount = 0;
+    for (size_t base = 0; base < headers.size(); base += VERIFY_GROUP) {
+        size_t count = std::min(VERIFY_GROUP, headers.size() - base);
+
+        // Stage 1: start fetching every header of the group
+        for (size_t i = 0; i < count; ++i) {
+            __builtin_prefetch(headers[base + i]);
+        }
+
+        // Stage 2: sum each 20-byte header as two 64-bit words and one 32-bit word
+        for (size_t i = 0; i < count; ++i) {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(headers[base + i]);
+            uint64_t headerSum = addCarry(addCarry(load64(bytes), load64(bytes + 8)), load32(bytes + 16));
+            bool ok = fold(headerSum) == 0xFFFF;
+            valid[base + i] = ok;
+            validCount += ok;
+        }
+    }
+    return validCount;
+}
+
+}  // namespace checksum
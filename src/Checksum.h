@@ -0,0 +1,64 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "protocol.h"
+
+/**
+ * Internet checksum (RFC 1071) kernels.
+ *
+ * The one's complement sum does not depend on byte order, so the kernels add the
+ * data in native-order words as wide as the CPU allows and swap the folded result
+ * once at the end. The widest kernel the CPU supports is picked on first use.
+ */
+namespace checksum {
+
+enum class Kernel {
+    Scalar, /**< 64-bit words with end-around carry. */
+    Sse2,   /**< 32 bytes per step, widened into 32-bit lanes. */
+    Avx2,   /**< 64 bytes per step, widened into 32-bit lanes. */
+};
+
+/**
+ * @brief Returns the kernel sum() uses on this CPU.
+ */
+Kernel activeKernel();
+
+/**
+ * @brief Returns whether the CPU can run a kernel.
+ */
+bool isSupported(Kernel kernel);
+
+const char* kernelName(Kernel kernel);
+
+/**
+ * @brief Computes the one's complement sum of data as big-endian 16-bit words.
+ * Buffers shorter than a few hundred bytes use the scalar kernel, which is faster
+ * there than setting up vector registers.
+ * @return The sum folded to 16 bits, in host byte order, before complementing. It
+ * is zero only if all of the data is zero.
+ */
+uint16_t sum(const void* data, size_t len);
+
+/**
+ * @brief Same as sum(), using the given kernel. The kernel must be supported.
+ */
+uint16_t sum(Kernel kernel, const void* data, size_t len);
+
+/**
+ * @brief Checks the checksums of many IPv4 headers in one pass.
+ *
+ * Headers are processed in groups whose memory is prefetched before any of them
+ * is summed, so cache misses on different packets overlap.
+ * @param headers Each must point to at least sizeof(sr_ip_hdr_t) readable bytes.
+ * @param valid Receives whether each header verifies. Must be as long as headers.
+ * @return The number of headers that verify.
+ */
+size_t verifyIpHeaders(std::span<const sr_ip_hdr_t* const> headers, std::span<bool> valid);
+
+}  // namespace checksum
+
+#endif  // CHECKSUM_H
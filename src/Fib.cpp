@@ -0,0 +1,478 @@
+#include "Fib.h"
+
+#include <arpa/inet.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "Rcu.h"
+
+FibEngine parseFibEngine(const std::string& name) {
+    if (name == "linear") {
+        return FibEngine::Linear;
+    }
+    if (name == "dir24-8") {
+        return FibEngine::Dir24_8;
+    }
+    throw std::invalid_argument("Unknown FIB engine: " + name);
+}
+
+const char* fibEngineName(FibEngine engine) {
+    switch (engine) {
+        case FibEngine::Linear:
+            return "linear";
+        case FibEngine::Dir24_8:
+            return "dir24-8";
+    }
+    return "unknown";
+}
+
+bool isContiguousMask(ip_addr mask) {
+    uint32_t hostMask = ntohl(mask);
+    // A contiguous mask inverted is 2^k - 1, so adding one clears every bit
+    return (~hostMask & (~hostMask + 1)) == 0;
+}
+
+void Fib::lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out) const {
+    for (size_t i = 0; i < ips.size(); ++i) {
+        out[i] = lookup(ips[i]);
+    }
+}
+
+LinearFib::LinearFib(const std::vector<FibRoute>& routes) {
+    // Longest mask first; the stable sort keeps the first of several equal prefixes in front
+    std::vector<size_t> order(routes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&routes](size_t a, size_t b) {
+        return __builtin_popcount(routes[a].mask) > __builtin_popcount(routes[b].mask);
+    });
+
+    struct Arrays {
+        std::vector<ip_addr> dests, masks;
+        std::vector<uint32_t> values;
+    };
+    auto arrays = std::make_shared<Arrays>();
+    arrays->dests.reserve(routes.size());
+    arrays->masks.reserve(routes.size());
+    arrays->values.reserve(routes.size());
+    for (size_t i : order) {
+        arrays->dests.push_back(routes[i].dest & routes[i].mask);
+        arrays->masks.push_back(routes[i].mask);
+        arrays->values.push_back(routes[i].value);
+    }
+
+    dests = arrays->dests;
+    masks = arrays->masks;
+    values = arrays->values;
+    storage = std::move(arrays);
+}
+
+LinearFib::LinearFib(std::shared_ptr<const void> storage, std::span<const ip_addr> dests,
+                     std::span<const ip_addr> masks, std::span<const uint32_t> values)
+    : storage(std::move(storage)), dests(dests), masks(masks), values(values) {
+    if (masks.size() != dests.size() || values.size() != dests.size()) {
+        throw std::invalid_argument("Linear FIB arrays differ in length");
+    }
+}
+
+uint32_t LinearFib::lookup(ip_addr ip) const {
+    return match(ip).value;
+}
+
+FibMatch LinearFib::match(ip_addr ip) const {
+    for (size_t i = 0; i < dests.size(); ++i) {
+        if ((ip & masks[i]) == dests[i]) {
+            return {values[i], masks[i]};
+        }
+    }
+    return {NO_MATCH, 0};
+}
+
+size_t LinearFib::memoryUsage() const {
+    return (dests.size() + masks.size() + values.size()) * sizeof(uint32_t);
+}
+
+std::vector<uint32_t> LinearFib::storedValues() const {
+    std::vector<uint32_t> stored(values.begin(), values.end());
+    stored.push_back(NO_MATCH);
+    std::sort(stored.begin(), stored.end());
+    stored.erase(std::unique(stored.begin(), stored.end()), stored.end());
+    return stored;
+}
+
+size_t LinearFib::memoryFor(size_t routeCount) {
+    return routeCount * 3 * sizeof(uint32_t);
+}
+
+Dir24_8Fib::Dir24_8Fib(const std::vector<FibRoute>& routes) {
+    struct Tables {
+        std::vector<uint32_t> tbl24, tbl8;
+    };
+    auto tables = std::make_shared<Tables>();
+    tables->tbl24.assign(TBL24_SIZE, EMPTY);
+
+    for (const auto& route : routes) {
+        if (!isContiguousMask(route.mask)) {
+            throw std::invalid_argument("DIR-24-8 requires contiguous subnet masks");
+        }
+        if (route.value > VALUE_MASK) {
+            throw std::invalid_argument("FIB value does not fit in 24 bits");
+        }
+        uint8_t length = __builtin_popcount(route.mask);
+        insert(tables->tbl24, tables->tbl8, ntohl(route.dest & route.mask), length, route.value);
+    }
+
+    // Leave room for the groups that in-place updates will need
+    uint32_t used = tables->tbl8.size() / 256;
+    uint32_t capacity = groupCapacity(used);
+    tables->tbl8.resize(size_t{capacity} * 256, EMPTY);
+    tables->tbl8.shrink_to_fit();
+
+    groupPool = std::make_shared<GroupPool>();
+    for (uint32_t group = capacity; group > used; --group) {
+        groupPool->free.push_back(group - 1);
+    }
+
+    tbl24 = tables->tbl24;
+    tbl8 = tables->tbl8;
+    storage = std::move(tables);
+}
+
+Dir24_8Fib::Dir24_8Fib(std::shared_ptr<const void> storage, std::span<uint32_t> tbl24, std::span<uint32_t> tbl8)
+    : storage(std::move(storage)), tbl24(tbl24), tbl8(tbl8), groupPool(std::make_shared<GroupPool>()) {
+    if (tbl24.size() != TBL24_SIZE || tbl8.size() % 256 != 0 || tbl8.size() / 256 > VALUE_MASK) {
+        throw std::invalid_argument("DIR-24-8 tables have the wrong size");
+    }
+
+    // Lookups index tbl8 without bounds checks. Groups nothing points to are free.
+    size_t groups = tbl8.size() / 256;
+    std::vector<bool> referenced(groups);
+    for (uint32_t entry : tbl24) {
+        if (entry & EXTENDED) {
+            if ((entry & VALUE_MASK) >= groups) {
+                throw std::invalid_argument("DIR-24-8 entry points past the last tbl8 group");
+            }
+            referenced[entry & VALUE_MASK] = true;
+        }
+    }
+    for (size_t group = groups; group > 0; --group) {
+        if (!referenced[group - 1]) {
+            groupPool->free.push_back(group - 1);
+        }
+    }
+}
+
+uint32_t Dir24_8Fib::groupCapacity(size_t used) {
+    return std::min<size_t>(used + std::max<size_t>(used / 8, MIN_SPARE_GROUPS), VALUE_MASK);
+}
+
+void Dir24_8Fib::insert(std::vector<uint32_t>& tbl24, std::vector<uint32_t>& tbl8, uint32_t prefix, uint8_t length,
+                        uint32_t value) {
+    uint32_t entry = VALID | (static_cast<uint32_t>(length) << DEPTH_SHIFT) | value;
+
+    // Only take over entries covered by a strictly shorter prefix (or none). An equal
+    // depth means the same prefix was inserted before, and the first one wins.
+    auto update = [&](uint32_t& slot) {
+        if (!(slot & VALID) || depthOf(slot) < length) {
+            slot = entry;
+        }
+    };
+
+    if (length <= 24) {
+        uint32_t first = prefix >> 8;
+        uint32_t count = 1u << (24 - length);
+        for (uint32_t i = first; i < first + count; ++i) {
+            if (tbl24[i] & EXTENDED) {
+                uint32_t group = tbl24[i] & VALUE_MASK;
+                for (uint32_t j = 0; j < 256; ++j) {
+                    update(tbl8[group * 256 + j]);
+                }
+            }
+            else {
+                update(tbl24[i]);
+            }
+        }
+        return;
+    }
+
+    uint32_t& head = tbl24[prefix >> 8];
+    if (!(head & EXTENDED)) {
+        // Push the /24 down into a new group so the longer prefix can be carved out of it
+        uint32_t group = tbl8.size() / 256;
+        tbl8.resize(tbl8.size() + 256, head);
+        head = EXTENDED | group;
+    }
+
+    uint32_t group = head & VALUE_MASK;
+    uint32_t first = prefix & 0xFF;
+    uint32_t count = 1u << (32 - length);
+    for (uint32_t j = first; j < first + count; ++j) {
+        update(tbl8[group * 256 + j]);
+    }
+}
+
+uint32_t Dir24_8Fib::entryFor(uint32_t addr) const {
+    uint32_t entry = load(tbl24[addr >> 8]);
+    if (entry & EXTENDED) {
+        entry = load(tbl8[(entry & VALUE_MASK) * 256 + (addr & 0xFF)]);
+    }
+    return entry;
+}
+
+uint32_t Dir24_8Fib::lookup(ip_addr ip) const {
+    return entryFor(ntohl(ip)) & VALUE_MASK;
+}
+
+FibMatch Dir24_8Fib::match(ip_addr ip) const {
+    uint32_t entry = entryFor(ntohl(ip));
+    if (!(entry & VALID)) {
+        return {NO_MATCH, 0};
+    }
+    uint32_t depth = depthOf(entry);
+    return {entry & VALUE_MASK, depth == 0 ? 0 : htonl(~0u << (32 - depth))};
+}
+
+void Dir24_8Fib::lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out) const {
+    uint32_t addrs[BATCH_STRIDE];
+    uint32_t entries[BATCH_STRIDE];
+
+    for (size_t base = 0; base < ips.size(); base += BATCH_STRIDE) {
+        size_t count = std::min(BATCH_STRIDE, ips.size() - base);
+
+        // Stage 1: start fetching the tbl24 entry of every address in the group
+        for (size_t i = 0; i < count; ++i) {
+            addrs[i] = ntohl(ips[base + i]);
+            __builtin_prefetch(&tbl24[addrs[i] >> 8]);
+        }
+
+        // Stage 2: read them, and start fetching the tbl8 entry where one is needed
+        for (size_t i = 0; i < count; ++i) {
+            entries[i] = load(tbl24[addrs[i] >> 8]);
+            if (entries[i] & EXTENDED) {
+                __builtin_prefetch(&tbl8[(entries[i] & VALUE_MASK) * 256 + (addrs[i] & 0xFF)]);
+            }
+        }
+
+        // Stage 3: resolve
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t entry = entries[i];
+            if (entry & EXTENDED) {
+                entry = load(tbl8[(entry & VALUE_MASK) * 256 + (addrs[i] & 0xFF)]);
+            }
+            out[base + i] = entry & VALUE_MASK;
+        }
+    }
+}
+
+bool Dir24_8Fib::updateRoute(ip_addr dest, ip_addr mask, uint32_t value) {
+    if (!isContiguousMask(mask) || value > VALUE_MASK) {
+        return false;
+    }
+    uint32_t prefix = ntohl(dest & mask);
+    uint32_t length = __builtin_popcount(mask);
+    uint32_t entry = VALID | (length << DEPTH_SHIFT) | value;
+
+    // Unlike insert(), an equal depth is this very prefix and gets its new value
+    auto update = [&](uint32_t& slot) {
+        uint32_t current = load(slot);
+        if (!(current & VALID) || depthOf(current) <= length) {
+            store(slot, entry);
+        }
+    };
+
+    if (length <= 24) {
+        uint32_t first = prefix >> 8;
+        uint32_t count = 1u << (24 - length);
+        for (uint32_t i = first; i < first + count; ++i) {
+            uint32_t head = load(tbl24[i]);
+            if (head & EXTENDED) {
+                uint32_t group = head & VALUE_MASK;
+                for (uint32_t j = 0; j < 256; ++j) {
+                    update(tbl8[group * 256 + j]);
+                }
+            }
+            else {
+                update(tbl24[i]);
+            }
+        }
+        return true;
+    }
+
+    uint32_t& headSlot = tbl24[prefix >> 8];
+    uint32_t head = load(headSlot);
+    if (!(head & EXTENDED)) {
+        uint32_t group;
+        {
+            std::lock_guard lock(groupPool->mutex);
+            if (groupPool->free.empty()) {
+                return false;
+            }
+            group = groupPool->free.back();
+            groupPool->free.pop_back();
+        }
+
+        // Fill the group before publishing it, so lookups never see it half-initialized
+        for (uint32_t j = 0; j < 256; ++j) {
+            store(tbl8[group * 256 + j], head);
+        }
+        head = EXTENDED | group;
+        store(headSlot, head);
+    }
+
+    uint32_t group = head & VALUE_MASK;
+    uint32_t first = prefix & 0xFF;
+    uint32_t count = 1u << (32 - length);
+    for (uint32_t j = first; j < first + count; ++j) {
+        update(tbl8[group * 256 + j]);
+    }
+    return true;
+}
+
+bool Dir24_8Fib::removeRoute(ip_addr dest, ip_addr mask, const FibRoute* covering) {
+    if (!isContiguousMask(mask)) {
+        return false;
+    }
+    uint32_t prefix = ntohl(dest & mask);
+    uint32_t length = __builtin_popcount(mask);
+
+    uint32_t replacement = EMPTY;
+    if (covering) {
+        replacement = VALID | (static_cast<uint32_t>(__builtin_popcount(covering->mask)) << DEPTH_SHIFT) |
+                      covering->value;
+    }
+
+    // Only one prefix of a given length covers an address, so the entries of this
+    // prefix are exactly those with its depth. Longer prefixes inside it stay.
+    auto clear = [&](uint32_t& slot) {
+        uint32_t current = load(slot);
+        if ((current & VALID) && depthOf(current) == length) {
+            store(slot, replacement);
+        }
+    };
+
+    if (length <= 24) {
+        uint32_t first = prefix >> 8;
+        uint32_t count = 1u << (24 - length);
+        for (uint32_t i = first; i < first + count; ++i) {
+            uint32_t head = load(tbl24[i]);
+            if (head & EXTENDED) {
+                uint32_t group = head & VALUE_MASK;
+                for (uint32_t j = 0; j < 256; ++j) {
+                    clear(tbl8[group * 256 + j]);
+                }
+            }
+            else {
+                clear(tbl24[i]);
+            }
+        }
+        return true;
+    }
+
+    uint32_t& headSlot = tbl24[prefix >> 8];
+    uint32_t head = load(headSlot);
+    if (!(head & EXTENDED)) {
+        return true;
+    }
+
+    uint32_t group = head & VALUE_MASK;
+    uint32_t first = prefix & 0xFF;
+    uint32_t count = 1u << (32 - length);
+    for (uint32_t j = first; j < first + count; ++j) {
+        clear(tbl8[group * 256 + j]);
+    }
+
+    // Without prefixes longer than /24 left, every entry of the group holds the same
+    // /24 (or shorter) match and the group can fold back into tbl24
+    for (uint32_t j = 0; j < 256; ++j) {
+        uint32_t entry = load(tbl8[group * 256 + j]);
+        if ((entry & VALID) && depthOf(entry) > 24) {
+            return true;
+        }
+    }
+    store(headSlot, load(tbl8[group * 256]));
+
+    // Lookups that read the old tbl24 entry may still be inside the group
+    rcu::retire([pool = groupPool, group] {
+        std::lock_guard lock(pool->mutex);
+        pool->free.push_back(group);
+    });
+    return true;
+}
+
+size_t Dir24_8Fib::memoryUsage() const {
+    return (tbl24.size() + tbl8.size()) * sizeof(uint32_t);
+}
+
+std::vector<uint32_t> Dir24_8Fib::storedValues() const {
+    // Neighbouring entries mostly repeat, so only keep the changes before sorting
+    std::vector<uint32_t> stored{NO_MATCH};
+    auto add = [&](uint32_t value) {
+        if (value != stored.back()) {
+            stored.push_back(value);
+        }
+    };
+    for (uint32_t entry : tbl24) {
+        if (!(entry & EXTENDED)) {
+            add(entry & VALUE_MASK);
+        }
+    }
+    for (uint32_t entry : tbl8) {
+        add(entry & VALUE_MASK);
+    }
+    std::sort(stored.begin(), stored.end());
+    stored.erase(std::unique(stored.begin(), stored.end()), stored.end());
+    return stored;
+}
+
+size_t Dir24_8Fib::memoryFor(const std::vector<FibRoute>& routes) {
+    // Every /24 that holds a longer prefix gets exactly one group
+    std::vector<uint32_t> extended;
+    for (const auto& route : routes) {
+        if (__builtin_popcount(route.mask) > 24) {
+            extended.push_back(ntohl(route.dest & route.mask) >> 8);
+        }
+    }
+    std::sort(extended.begin(), extended.end());
+    size_t used = std::unique(extended.begin(), extended.end()) - extended.begin();
+    return (TBL24_SIZE + size_t{groupCapacity(used)} * 256) * sizeof(uint32_t);
+}
+
+std::unique_ptr<Fib> buildFib(FibEngine engine, const std::vector<FibRoute>& routes) {
+    if (engine == FibEngine::Dir24_8) {
+        bool contiguous = std::all_of(routes.begin(), routes.end(),
+                                      [](const FibRoute& route) { return isContiguousMask(route.mask); });
+        if (contiguous) {
+            return std::make_unique<Dir24_8Fib>(routes);
+        }
+        spdlog::warn("Routing table has non-contiguous subnet masks. Falling back to the linear FIB.");
+    }
+    return std::make_unique<LinearFib>(routes);
+}
+
+size_t fibMemoryFor(FibEngine engine, const std::vector<FibRoute>& routes) {
+    if (engine == FibEngine::Dir24_8 && std::all_of(routes.begin(), routes.end(), [](const FibRoute& route) {
+            return isContiguousMask(route.mask);
+        })) {
+        return Dir24_8Fib::memoryFor(routes);
+    }
+    return LinearFib::memoryFor(routes.size());
+}
+
+std::unique_ptr<Fib> loadFib(FibEngine engine, std::shared_ptr<const void> storage,
+                             const std::vector<std::span<uint32_t>>& tables) {
+    switch (engine) {
+        case FibEngine::Linear:
+            if (tables.size() == 3) {
+                return std::make_unique<LinearFib>(std::move(storage), tables[0], tables[1], tables[2]);
+            }
+            break;
+        case FibEngine::Dir24_8:
+            if (tables.size() == 2) {
+                return std::make_unique<Dir24_8Fib>(std::move(storage), tables[0], tables[1]);
+            }
+            break;
+    }
+    throw std::invalid_argument(std::string("Wrong number of tables for the ") + fibEngineName(engine) + " FIB");
+}
@@ -0,0 +1,298 @@
+#ifndef FIB_H
+#define FIB_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "RouterTypes.h"
+
+/**
+ * @enum FibEngine
+ * @brief Selects the longest prefix match structure compiled from the routing table.
+ */
+enum class FibEngine {
+    Linear,  /**< Scan every prefix, longest first. Reference implementation. */
+    Dir24_8  /**< 2^24-entry first level plus 256-entry second level groups. */
+};
+
+/**
+ * @brief Parses an engine name as given on the command line ("linear" or "dir24-8").
+ * @throws std::invalid_argument if the name is unknown.
+ */
+FibEngine parseFibEngine(const std::string& name);
+
+/**
+ * @brief Returns the command line name of the given engine.
+ */
+const char* fibEngineName(FibEngine engine);
+
+/**
+ * @struct FibRoute
+ * @brief A prefix handed to the FIB builder.
+ *
+ * Addresses are in network byte order, exactly as they are stored in RoutingEntry.
+ */
+struct FibRoute {
+    ip_addr dest;   /**< Destination prefix. */
+    ip_addr mask;   /**< Subnet mask of the prefix. */
+    uint32_t value; /**< Opaque value returned by lookups that match this prefix (24 bits). */
+};
+
+/**
+ * @struct FibMatch
+ * @brief The value of the longest matching prefix together with that prefix's mask.
+ */
+struct FibMatch {
+    uint32_t value; /**< Value of the matching route, or Fib::NO_MATCH. */
+    ip_addr mask;   /**< Mask of the matching route in network byte order (0 if none). */
+};
+
+/**
+ * @class Fib
+ * @brief A compiled, read-only longest prefix match structure.
+ *
+ * Lookups return the value of the longest matching prefix. When several routes share
+ * the same prefix the first one handed to the builder wins, which matches the
+ * behaviour of the original linear scan.
+ */
+class Fib {
+   public:
+    /** Returned by lookup() when no prefix matches. Also the largest storable value + 1. */
+    static constexpr uint32_t NO_MATCH = 0x00FFFFFF;
+
+    virtual ~Fib() = default;
+
+    /**
+     * @brief Finds the longest prefix matching the given address.
+     * @param ip The address to look up, in network byte order.
+     * @return The value of the matching route, or NO_MATCH.
+     */
+    virtual uint32_t lookup(ip_addr ip) const = 0;
+
+    /**
+     * @brief Like lookup(), but also reports which prefix length matched.
+     */
+    virtual FibMatch match(ip_addr ip) const = 0;
+
+    /**
+     * @brief Looks up many addresses at once.
+     *
+     * Engines that touch large tables override this to issue the memory accesses of a
+     * whole group of addresses before using any of them, so that cache misses overlap.
+     * @param ips Addresses in network byte order.
+     * @param out Receives one lookup() result per address; must be at least as long as ips.
+     */
+    virtual void lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out) const;
+
+    /**
+     * @brief Returns the number of bytes used by the lookup structure.
+     */
+    virtual size_t memoryUsage() const = 0;
+
+    virtual FibEngine engine() const = 0;
+
+    /**
+     * @brief Returns every value a lookup can return, NO_MATCH included, sorted and
+     * without duplicates. Used to check FIBs loaded from a file.
+     */
+    virtual std::vector<uint32_t> storedValues() const = 0;
+
+    /**
+     * @brief Returns the arrays that make up the compiled structure, for serialization.
+     *
+     * Handing the same arrays to loadFib() yields an equivalent FIB without rebuilding it.
+     */
+    virtual std::vector<std::span<const uint32_t>> tables() const = 0;
+
+    /**
+     * @brief Adds a prefix, or changes its value, while lookups continue.
+     *
+     * Each address switches to the new value with a single atomic store. Calls to
+     * updateRoute() and removeRoute() must be serialized by the caller.
+     * @return False if the engine cannot apply the update in place. The FIB is then
+     * unchanged and has to be rebuilt.
+     */
+    virtual bool updateRoute([[maybe_unused]] ip_addr dest, [[maybe_unused]] ip_addr mask,
+                             [[maybe_unused]] uint32_t value) {
+        return false;
+    }
+
+    /**
+     * @brief Removes a prefix while lookups continue.
+     * @param covering The longest remaining prefix that contains the removed one, which
+     * the addresses of the removed prefix fall back to, or nullptr if there is none.
+     * @return False if the engine cannot apply the update in place, as for updateRoute().
+     */
+    virtual bool removeRoute([[maybe_unused]] ip_addr dest, [[maybe_unused]] ip_addr mask,
+                             [[maybe_unused]] const FibRoute* covering) {
+        return false;
+    }
+};
+
+/**
+ * @class LinearFib
+ * @brief Keeps the prefixes sorted by mask length and returns the first match.
+ *
+ * Prefixes, masks and values are kept in separate arrays so that the scan only
+ * streams through the two arrays it compares against. This is the only engine that
+ * accepts non-contiguous masks. It is never updated in place.
+ */
+class LinearFib : public Fib {
+   public:
+    explicit LinearFib(const std::vector<FibRoute>& routes);
+
+    /**
+     * @brief Uses arrays previously returned by tables(), kept alive by storage.
+     * @throws std::invalid_argument if the arrays differ in length.
+     */
+    LinearFib(std::shared_ptr<const void> storage, std::span<const ip_addr> dests, std::span<const ip_addr> masks,
+              std::span<const uint32_t> values);
+
+    uint32_t lookup(ip_addr ip) const override;
+
+    FibMatch match(ip_addr ip) const override;
+
+    size_t memoryUsage() const override;
+
+    /** @brief Returns the memoryUsage() of a LinearFib built from the given number of routes. */
+    static size_t memoryFor(size_t routeCount);
+
+    FibEngine engine() const override { return FibEngine::Linear; }
+
+    std::vector<uint32_t> storedValues() const override;
+
+    std::vector<std::span<const uint32_t>> tables() const override { return {dests, masks, values}; }
+
+   private:
+    std::shared_ptr<const void> storage; /**< Owns the arrays below (vectors or a mapped file). */
+    std::span<const ip_addr> dests;      /**< Masked prefixes, longest mask first. */
+    std::span<const ip_addr> masks;      /**< Masks, parallel to dests. */
+    std::span<const uint32_t> values;    /**< Route values, parallel to dests. */
+};
+
+/**
+ * @class Dir24_8Fib
+ * @brief The DIR-24-8 scheme: one memory access for prefixes up to /24, two beyond.
+ *
+ * Every tbl24 entry covers a /24. Entries for /24s that contain longer prefixes point
+ * to a 256-entry tbl8 group indexed by the last octet. Each entry stores the matched
+ * prefix length next to the value so that a longer prefix never gets overwritten by
+ * a shorter one, whatever the insertion order.
+ *
+ * Routes can be added and removed in place: an update touches the 2^(24 - length)
+ * tbl24 entries of the prefix (and the groups below them), or a single group for
+ * prefixes longer than /24, independent of the table size. Entries are read and
+ * written atomically. tbl8 groups come from a pool with a fixed capacity; groups that
+ * are no longer needed return to it once no lookup can still be reading them.
+ */
+class Dir24_8Fib : public Fib {
+   public:
+    /**
+     * @throws std::invalid_argument if a route has a non-contiguous mask or a value
+     * that does not fit in 24 bits.
+     */
+    explicit Dir24_8Fib(const std::vector<FibRoute>& routes);
+
+    /**
+     * @brief Uses tables previously returned by tables(), kept alive by storage.
+     * @throws std::invalid_argument if the tables are inconsistent.
+     */
+    Dir24_8Fib(std::shared_ptr<const void> storage, std::span<uint32_t> tbl24, std::span<uint32_t> tbl8);
+
+    uint32_t lookup(ip_addr ip) const override;
+
+    FibMatch match(ip_addr ip) const override;
+
+    void lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out) const override;
+
+    size_t memoryUsage() const override;
+
+    /**
+     * @brief Returns the memoryUsage() of a Dir24_8Fib built from the given routes,
+     * counting its tbl8 groups without filling any table.
+     */
+    static size_t memoryFor(const std::vector<FibRoute>& routes);
+
+    FibEngine engine() const override { return FibEngine::Dir24_8; }
+
+    std::vector<uint32_t> storedValues() const override;
+
+    std::vector<std::span<const uint32_t>> tables() const override { return {tbl24, tbl8}; }
+
+    /** @return False if the tbl8 pool is exhausted. */
+    bool updateRoute(ip_addr dest, ip_addr mask, uint32_t value) override;
+
+    bool removeRoute(ip_addr dest, ip_addr mask, const FibRoute* covering) override;
+
+   private:
+    static constexpr uint32_t VALID = 1u << 31;     /**< Some prefix covers this entry. */
+    static constexpr uint32_t EXTENDED = 1u << 30;  /**< tbl24 entry points to a tbl8 group. */
+    static constexpr uint32_t DEPTH_SHIFT = 24;
+    static constexpr uint32_t DEPTH_MASK = 0x3F;
+    static constexpr uint32_t VALUE_MASK = 0x00FFFFFF;
+    static constexpr uint32_t EMPTY = NO_MATCH;
+    static constexpr size_t BATCH_STRIDE = 16; /**< Lookups kept in flight by lookupBatch(). */
+    static constexpr size_t TBL24_SIZE = size_t{1} << 24;
+    static constexpr size_t MIN_SPARE_GROUPS = 1024; /**< tbl8 headroom for in-place updates. */
+
+    /**
+     * @struct GroupPool
+     * @brief tbl8 groups that are free to be handed out by updateRoute().
+     */
+    struct GroupPool {
+        std::mutex mutex; /**< Groups are returned from RCU reclamation, on any thread. */
+        std::vector<uint32_t> free;
+    };
+
+    static void insert(std::vector<uint32_t>& tbl24, std::vector<uint32_t>& tbl8, uint32_t prefix, uint8_t length,
+                       uint32_t value);
+
+    /** @brief Returns the tbl8 groups allocated for the given number in use, spares included. */
+    static uint32_t groupCapacity(size_t used);
+
+    uint32_t entryFor(uint32_t addr) const;
+
+    static uint32_t depthOf(uint32_t entry) { return (entry >> DEPTH_SHIFT) & DEPTH_MASK; }
+
+    static uint32_t load(const uint32_t& slot) { return __atomic_load_n(&slot, __ATOMIC_ACQUIRE); }
+
+    static void store(uint32_t& slot, uint32_t entry) { __atomic_store_n(&slot, entry, __ATOMIC_RELEASE); }
+
+    std::shared_ptr<const void> storage;   /**< Owns the tables below (vectors or a mapped file). */
+    std::span<uint32_t> tbl24;             /**< 2^24 entries indexed by the top 24 address bits. */
+    std::span<uint32_t> tbl8;              /**< 256-entry groups indexed by the last octet. */
+    std::shared_ptr<GroupPool> groupPool;  /**< Shared with pending reclamations. */
+};
+
+/**
+ * @brief Compiles the given routes with the requested engine.
+ *
+ * Falls back to the linear engine if the routes cannot be represented by the
+ * requested one (non-contiguous masks).
+ */
+std::unique_ptr<Fib> buildFib(FibEngine engine, const std::vector<FibRoute>& routes);
+
+/**
+ * @brief Returns the memoryUsage() of the FIB that buildFib() would compile from the
+ * given routes, without building it.
+ */
+size_t fibMemoryFor(FibEngine engine, const std::vector<FibRoute>& routes);
+
+/**
+ * @brief Recreates a FIB from the arrays returned by Fib::tables() of the given engine.
+ * @param storage Keeps the arrays alive for as long as the FIB exists.
+ * @throws std::invalid_argument if the arrays do not form a valid FIB.
+ */
+std::unique_ptr<Fib> loadFib(FibEngine engine, std::shared_ptr<const void> storage,
+                             const std::vector<std::span<uint32_t>>& tables);
+
+/**
+ * @brief Returns true if the mask (network byte order) is a run of ones followed by zeros.
+ */
+bool isContiguousMask(ip_addr mask);
+
+#endif  // FIB_H
@@ -0,0 +1,208 @@
+#include "FibAggregation.h"
+
+#include <arpa/inet.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+FibVerifyMode parseFibVerifyMode(const std::string& name) {
+    if (name == "none") {
+        return FibVerifyMode::None;
+    }
+    if (name == "random") {
+        return FibVerifyMode::Random;
+    }
+    if (name == "exhaustive") {
+        return FibVerifyMode::Exhaustive;
+    }
+    throw std::invalid_argument("Unknown FIB verification mode: " + name);
+}
+
+namespace {
+
+constexpr uint32_t NO_CHILD = 0; /**< The root is never a child. */
+constexpr uint32_t NO_VALUE = UINT32_MAX;
+
+class OrtcTrie {
+   public:
+    explicit OrtcTrie(const std::vector<FibRoute>& routes) {
+        nodes.emplace_back();
+        for (const auto& route : routes) {
+            uint32_t prefix = ntohl(route.dest & route.mask);
+            uint32_t length = __builtin_popcount(route.mask);
+            uint32_t node = 0;
+            for (uint32_t depth = 0; depth < length; ++depth) {
+                node = child(node, (prefix >> (31 - depth)) & 1);
+            }
+            nodes[node].value = route.value;
+        }
+    }
+
+    std::vector<FibRoute> aggregate() {
+        normalize(0, Fib::NO_MATCH);
+        computeSets(0);
+
+        std::vector<FibRoute> result;
+        // No route is the same as an explicit unreachable default
+        uint32_t rootChoice = contains(0, Fib::NO_MATCH) ? Fib::NO_MATCH : sets[nodes[0].setOffset];
+        if (rootChoice != Fib::NO_MATCH) {
+            result.push_back({0, 0, rootChoice});
+        }
+        select(0, 0, 0, rootChoice, result);
+        return result;
+    }
+
+   private:
+    struct Node {
+        uint32_t children[2] = {NO_CHILD, NO_CHILD};
+        uint32_t value = NO_VALUE;
+        uint32_t setOffset = 0; /**< The node's candidate next hops: sets[setOffset, setOffset + setSize). */
+        uint32_t setSize = 0;
+    };
+
+    uint32_t child(uint32_t node, uint32_t bit) {
+        if (nodes[node].children[bit] == NO_CHILD) {
+            uint32_t created = nodes.size();
+            nodes.emplace_back();
+            nodes[node].children[bit] = created;
+        }
+        return nodes[node].children[bit];
+    }
+
+    // Pass 1: complete the trie so every node has zero or two children, and push the
+    // next hop in effect at each node down to the leaves
+    void normalize(uint32_t node, uint32_t inherited) {
+        if (nodes[node].value == NO_VALUE) {
+            nodes[node].value = inherited;
+        }
+        uint32_t value = nodes[node].value;
+        if (nodes[node].children[0] == NO_CHILD && nodes[node].children[1] == NO_CHILD) {
+            return;
+        }
+        for (uint32_t bit = 0; bit < 2; ++bit) {
+            uint32_t next = child(node, bit);
+            normalize(next, value);
+        }
+    }
+
+    // Pass 2: bottom-up, the intersection of the children's sets if not empty, else their union
+    void computeSets(uint32_t node) {
+        uint32_t left = nodes[node].children[0];
+        uint32_t right = nodes[node].children[1];
+        if (left == NO_CHILD) {
+            nodes[node].setOffset = sets.size();
+            nodes[node].setSize = 1;
+            sets.push_back(nodes[node].value);
+            return;
+        }
+
+        computeSets(left);
+        computeSets(right);
+
+        auto a = sets.begin() + nodes[left].setOffset;
+        auto b = sets.begin() + nodes[right].setOffset;
+        merged.clear();
+        std::set_intersection(a, a + nodes[left].setSize, b, b + nodes[right].setSize, std::back_inserter(merged));
+        if (merged.empty()) {
+            std::set_union(a, a + nodes[left].setSize, b, b + nodes[right].setSize, std::back_inserter(merged));
+        }
+
+        nodes[node].setOffset = sets.size();
+        nodes[node].setSize = merged.size();
+        sets.insert(sets.end(), merged.begin(), merged.end());
+    }
+
+    bool contains(uint32_t node, uint32_t value) const {
+        auto begin = sets.begin() + nodes[node].setOffset;
+        return std::binary_search(begin, begin + nodes[node].setSize, value);
+    }
+
+    // Pass 3: top-down, keep the inherited next hop where it is a candidate and emit a
+    // prefix where it is not
+    void select(uint32_t node, uint32_t prefix, uint32_t depth, uint32_t inherited, std::vector<FibRoute>& result) {
+        for (uint32_t bit = 0; bit < 2; ++bit) {
+            uint32_t next = nodes[node].children[bit];
+            if (next == NO_CHILD) {
+                continue;
+            }
+            uint32_t childPrefix = prefix | (bit << (31 - depth));
+            uint32_t chosen = inherited;
+            if (!contains(next, inherited)) {
+                chosen = sets[nodes[next].setOffset];
+                uint32_t mask = ~0u << (31 - depth);
+                result.push_back({htonl(childPrefix), htonl(mask), chosen});
+            }
+            select(next, childPrefix, depth + 1, chosen, result);
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> sets;
+    std::vector<uint32_t> merged; /**< Scratch space for computeSets(). */
+};
+
+}  // namespace
+
+std::vector<FibRoute> aggregateRoutes(const std::vector<FibRoute>& routes) {
+    bool contiguous = std::all_of(routes.begin(), routes.end(),
+                                  [](const FibRoute& route) { return isContiguousMask(route.mask); });
+    if (!contiguous) {
+        spdlog::warn("Routing table has non-contiguous subnet masks. Not aggregating.");
+        return routes;
+    }
+    return OrtcTrie(routes).aggregate();
+}
+
+uint64_t compareFibs(const Fib& expected, const Fib& actual, FibVerifyMode mode, const std::vector<FibRoute>& routes) {
+    constexpr size_t BATCH = 4096;
+    std::vector<ip_addr> ips;
+    std::vector<uint32_t> expectedValues(BATCH), actualValues(BATCH);
+    uint64_t mismatches = 0;
+
+    auto flush = [&] {
+        expected.lookupBatch(ips, expectedValues);
+        actual.lookupBatch(ips, actualValues);
+        for (size_t i = 0; i < ips.size(); ++i) {
+            if (expectedValues[i] != actualValues[i]) {
+                if (mismatches++ < 10) {
+                    char address[INET_ADDRSTRLEN];
+                    inet_ntop(AF_INET, &ips[i], address, sizeof(address));
+                    spdlog::error("FIB mismatch for {}: expected {}, got {}.", address, expectedValues[i],
+                                  actualValues[i]);
+                }
+            }
+        }
+        ips.clear();
+    };
+    auto check = [&](uint32_t hostAddr) {
+        ips.push_back(htonl(hostAddr));
+        if (ips.size() == BATCH) {
+            flush();
+        }
+    };
+
+    if (mode == FibVerifyMode::Exhaustive) {
+        for (uint64_t addr = 0; addr <= UINT32_MAX; ++addr) {
+            check(addr);
+        }
+    }
+    else if (mode == FibVerifyMode::Random) {
+        std::mt19937 rng(489);
+        for (const auto& route : routes) {
+            uint32_t first = ntohl(route.dest & route.mask);
+            uint32_t hostMask = ~ntohl(route.mask);
+            check(first);
+            check(first | hostMask);
+            check(first | (rng() & hostMask));
+        }
+        for (size_t i = 0; i < std::max<size_t>(routes.size(), 1 << 20); ++i) {
+            check(rng());
+        }
+    }
+    flush();
+
+    return mismatches;
+}
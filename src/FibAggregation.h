@@ -0,0 +1,60 @@
+#ifndef FIBAGGREGATION_H
+#define FIBAGGREGATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Fib.h"
+
+/**
+ * @enum FibVerifyMode
+ * @brief How an aggregated FIB is checked against the FIB of the original routes.
+ */
+enum class FibVerifyMode {
+    None,       /**< Trust the aggregation. */
+    Random,     /**< Both ends and a random address of every original prefix, plus random addresses. */
+    Exhaustive  /**< All 2^32 addresses. Takes seconds; meant for offline compilation. */
+};
+
+/**
+ * @struct AggregationOptions
+ * @brief Whether a routing table aggregates its routes before compiling them, and how
+ * the result is checked when the whole table is loaded.
+ */
+struct AggregationOptions {
+    bool enabled = false;
+    FibVerifyMode verify = FibVerifyMode::None;
+};
+
+/**
+ * @brief Parses a verification mode as given on the command line ("none", "random" or "exhaustive").
+ * @throws std::invalid_argument if the name is unknown.
+ */
+FibVerifyMode parseFibVerifyMode(const std::string& name);
+
+/**
+ * @brief Rewrites routes into the smallest set of prefixes that forwards identically.
+ *
+ * Implements ORTC (Optimal Routing Table Constructor, Draves et al.): the routes are
+ * put in a binary trie, next hops are pushed down to the leaves of the completed trie,
+ * every node is given the set of next hops that would serve all its leaves with the
+ * fewest prefixes (intersection of the children's sets if not empty, union otherwise),
+ * and prefixes are then only emitted where the inherited next hop is not in the set.
+ *
+ * Values are compared as opaque integers. Addresses that had no route may end up inside
+ * a shorter aggregate; the output then contains an explicit route with the value
+ * Fib::NO_MATCH for them, which lookups report as no match.
+ *
+ * Routes with non-contiguous masks cannot be aggregated; they are returned unchanged.
+ * The routes must not contain the same prefix twice.
+ */
+std::vector<FibRoute> aggregateRoutes(const std::vector<FibRoute>& routes);
+
+/**
+ * @brief Looks up the same addresses in both FIBs and counts the ones they disagree on.
+ * @param routes The routes the expected FIB was built from, used to pick addresses.
+ */
+uint64_t compareFibs(const Fib& expected, const Fib& actual, FibVerifyMode mode, const std::vector<FibRoute>& routes);
+
+#endif  // FIBAGGREGATION_H
@@ -0,0 +1,240 @@
+#include "FibSnapshot.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "MappedFile.h"
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC = {'S', 'R', 'F', 'I', 'B', 'S', 'N', 'P'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr size_t ALIGNMENT = 64;
+constexpr size_t MAX_FIB_TABLES = 4;
+constexpr uint32_t FLAG_AGGREGATED = 1; /**< The FIB was built from aggregated routes. */
+
+enum Section {
+    ROUTE_DESTS,
+    ROUTE_MASKS,
+    ROUTE_NEXT_HOPS,
+    NEXT_HOP_GATEWAYS,
+    NEXT_HOP_INTERFACES,
+    NEXT_HOP_GROUPS,
+    INTERFACE_NAMES, /**< Names separated by NUL bytes. */
+    FIB_TABLES,      /**< The arrays of Fib::tables(), in order. */
+    SECTION_COUNT = FIB_TABLES + MAX_FIB_TABLES
+};
+
+struct SectionEntry {
+    uint64_t offset;
+    uint64_t size; /**< In bytes. */
+};
+
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t engine;
+    uint32_t fibTableCount;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t hash;
+    SectionEntry sections[SECTION_COUNT];
+};
+
+// Four independent multiply-xorshift lanes over 64-bit words, so that the
+// multiplications overlap and hashing keeps up with reading the mapped file.
+uint64_t hashBytes(std::span<const std::byte> bytes, uint64_t seed) {
+    constexpr uint64_t PRIME = 0x9E3779B97F4A7C15;
+    uint64_t lanes[4] = {seed, seed + PRIME, seed + 2 * PRIME, seed + 3 * PRIME};
+
+    auto mix = [&](const std::byte* block) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, block + lane * sizeof(word), sizeof(word));
+            lanes[lane] = (lanes[lane] ^ word) * PRIME;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    };
+
+    size_t offset = 0;
+    for (; offset + 32 <= bytes.size(); offset += 32) {
+        mix(bytes.data() + offset);
+    }
+    if (offset < bytes.size()) {
+        std::byte tail[32] = {};
+        std::copy(bytes.begin() + offset, bytes.end(), tail);
+        mix(tail);
+    }
+
+    uint64_t hash = bytes.size();
+    for (uint64_t lane : lanes) {
+        hash = (hash ^ lane) * PRIME;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+uint64_t computeHash(const Header& header, std::span<const std::byte> payload) {
+    Header unhashed = header;
+    unhashed.hash = 0;
+    return hashBytes(payload, hashBytes(std::as_bytes(std::span(&unhashed, 1)), 0));
+}
+
+std::string toHex(uint64_t hash) {
+    return fmt::format("{:016x}", hash);
+}
+
+size_t alignUp(size_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+template <typename T>
+std::span<T> sectionOf(const Header& header, Section index, std::span<std::byte> file,
+                             const std::filesystem::path& path) {
+    const SectionEntry& entry = header.sections[index];
+    if (entry.offset % ALIGNMENT != 0 || entry.size % sizeof(T) != 0 || entry.offset > file.size() ||
+        entry.size > file.size() - entry.offset) {
+        throw std::runtime_error(path.string() + " is corrupt (bad section)");
+    }
+    return {reinterpret_cast<T*>(file.data() + entry.offset), entry.size / sizeof(T)};
+}
+
+}  // namespace
+
+void FibSnapshot::write(const std::filesystem::path& path, const FibSnapshotContents& contents) {
+    std::vector<std::span<const uint32_t>> fibTables = contents.fib->tables();
+    if (fibTables.size() > MAX_FIB_TABLES) {
+        throw std::runtime_error("FIB has too many tables for a snapshot");
+    }
+
+    std::string names;
+    for (std::string_view name : contents.interfaceNames) {
+        names.append(name);
+        names.push_back('\0');
+    }
+
+    std::vector<std::span<const std::byte>> sections(SECTION_COUNT);
+    sections[ROUTE_DESTS] = std::as_bytes(contents.routeDests);
+    sections[ROUTE_MASKS] = std::as_bytes(contents.routeMasks);
+    sections[ROUTE_NEXT_HOPS] = std::as_bytes(contents.routeNextHops);
+    sections[NEXT_HOP_GATEWAYS] = std::as_bytes(contents.nextHopGateways);
+    sections[NEXT_HOP_INTERFACES] = std::as_bytes(contents.nextHopInterfaces);
+    sections[NEXT_HOP_GROUPS] = std::as_bytes(contents.nextHopGroups);
+    sections[INTERFACE_NAMES] = std::as_bytes(std::span(names));
+    for (size_t i = 0; i < fibTables.size(); ++i) {
+        sections[FIB_TABLES + i] = std::as_bytes(fibTables[i]);
+    }
+
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.engine = static_cast<uint32_t>(contents.fib->engine());
+    header.fibTableCount = fibTables.size();
+    header.flags = contents.aggregated ? FLAG_AGGREGATED : 0;
+
+    // Lay out the payload in memory first: it is hashed before anything is written
+    size_t offset = alignUp(sizeof(Header));
+    for (size_t i = 0; i < SECTION_COUNT; ++i) {
+        header.sections[i] = {offset, sections[i].size()};
+        offset = alignUp(offset + sections[i].size());
+    }
+    std::vector<std::byte> payload(offset - alignUp(sizeof(Header)));
+    for (size_t i = 0; i < SECTION_COUNT; ++i) {
+        std::copy(sections[i].begin(), sections[i].end(),
+                  payload.begin() + (header.sections[i].offset - alignUp(sizeof(Header))));
+    }
+
+    uint64_t hash = computeHash(header, payload);
+    header.hash = hash;
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Failed to create " + temporary.string());
+        }
+        std::vector<char> headerBlock(alignUp(sizeof(Header)), 0);
+        std::memcpy(headerBlock.data(), &header, sizeof(header));
+        file.write(headerBlock.data(), headerBlock.size());
+        file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+        if (!file.flush()) {
+            throw std::runtime_error("Failed to write " + temporary.string());
+        }
+    }
+    std::filesystem::rename(temporary, path);
+
+    spdlog::info("Wrote {} FIB snapshot {} ({} routes, {} KiB, hash {}).", fibEngineName(contents.fib->engine()),
+                 path.string(), contents.routeDests.size(), (alignUp(sizeof(Header)) + payload.size()) / 1024,
+                 toHex(hash));
+}
+
+FibSnapshot::FibSnapshot(const std::filesystem::path& path) {
+    auto file = std::make_shared<MappedFile>(path, true);
+    std::span<std::byte> bytes = file->bytes();
+
+    Header header;
+    if (bytes.size() < alignUp(sizeof(Header))) {
+        throw std::runtime_error(path.string() + " is not a FIB snapshot");
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != MAGIC) {
+        throw std::runtime_error(path.string() + " is not a FIB snapshot");
+    }
+    if (header.byteOrder != BYTE_ORDER_MARK) {
+        throw std::runtime_error(path.string() + " was written on a machine with a different byte order");
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error(path.string() + " has snapshot version " + std::to_string(header.version) +
+                                 ", expected " + std::to_string(VERSION));
+    }
+    if (header.fibTableCount > MAX_FIB_TABLES) {
+        throw std::runtime_error(path.string() + " is corrupt");
+    }
+
+    std::span<std::byte> payload = bytes.subspan(alignUp(sizeof(Header)));
+    if (computeHash(header, payload) != header.hash) {
+        throw std::runtime_error(path.string() + " is corrupt (hash mismatch)");
+    }
+    hexHash = toHex(header.hash);
+    data.aggregated = header.flags & FLAG_AGGREGATED;
+
+    data.routeDests = sectionOf<ip_addr>(header, ROUTE_DESTS, bytes, path);
+    data.routeMasks = sectionOf<ip_addr>(header, ROUTE_MASKS, bytes, path);
+    data.routeNextHops = sectionOf<uint32_t>(header, ROUTE_NEXT_HOPS, bytes, path);
+    data.nextHopGateways = sectionOf<ip_addr>(header, NEXT_HOP_GATEWAYS, bytes, path);
+    data.nextHopInterfaces = sectionOf<uint32_t>(header, NEXT_HOP_INTERFACES, bytes, path);
+    data.nextHopGroups = sectionOf<uint32_t>(header, NEXT_HOP_GROUPS, bytes, path);
+    if (data.routeMasks.size() != data.routeDests.size() || data.routeNextHops.size() != data.routeDests.size() ||
+        data.nextHopInterfaces.size() != data.nextHopGateways.size()) {
+        throw std::runtime_error(path.string() + " is corrupt (section sizes differ)");
+    }
+
+    std::span<char> names = sectionOf<char>(header, INTERFACE_NAMES, bytes, path);
+    for (auto it = names.begin(); it != names.end();) {
+        auto nul = std::find(it, names.end(), '\0');
+        if (nul == names.end()) {
+            throw std::runtime_error(path.string() + " is corrupt (bad interface names)");
+        }
+        data.interfaceNames.emplace_back(&*it, nul - it);
+        it = nul + 1;
+    }
+
+    // The mapping is private and writable: in-place FIB updates never reach the file
+    std::vector<std::span<uint32_t>> fibTables;
+    for (uint32_t i = 0; i < header.fibTableCount; ++i) {
+        fibTables.push_back(sectionOf<uint32_t>(header, static_cast<Section>(FIB_TABLES + i), bytes, path));
+    }
+    try {
+        data.fib = loadFib(static_cast<FibEngine>(header.engine), file, fibTables);
+    } catch (const std::invalid_argument& e) {
+        throw std::runtime_error(path.string() + " is corrupt (" + e.what() + ")");
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef FIBSNAPSHOT_H
+#define FIBSNAPSHOT_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Fib.h"
+#include "IRoutingTable.h"
+
+/**
+ * @struct FibSnapshotContents
+ * @brief Everything a RoutingTable needs to start forwarding without compiling its FIB.
+ *
+ * Next hop i is (nextHopGateways[i], nextHopInterfaces[i]); interface ids index
+ * interfaceNames. Route and FIB values are the table's own encoding of next hops and
+ * next hop groups, which the table validates when it loads them.
+ */
+struct FibSnapshotContents {
+    std::span<const ip_addr> routeDests;          /**< Routing entries in file order. */
+    std::span<const ip_addr> routeMasks;          /**< Parallel to routeDests. */
+    std::span<const uint32_t> routeNextHops;      /**< Parallel to routeDests. */
+    std::span<const ip_addr> nextHopGateways;
+    std::span<const uint32_t> nextHopInterfaces;
+    std::span<const uint32_t> nextHopGroups;      /**< Equal-cost groups: member count, then the members. */
+    std::vector<std::string_view> interfaceNames;
+    std::shared_ptr<Fib> fib;
+    bool aggregated = false; /**< The FIB forwards like the routes but was built from fewer prefixes. */
+};
+
+/**
+ * @class FibSnapshot
+ * @brief A compiled routing table stored in a file that is mapped instead of parsed.
+ *
+ * Layout: a fixed header followed by the sections listed in it, each 64-byte
+ * aligned and stored in host byte order. The header records a format version, the
+ * byte order, the FIB engine, whether the FIB was built from aggregated routes, and a
+ * 64-bit hash of the whole file (computed with the hash field zeroed) that is checked
+ * on load and identifies the table in the logs.
+ *
+ * The file is mapped privately and writable, so the FIB can be modified in memory
+ * without touching the file.
+ */
+class FibSnapshot {
+   public:
+    static constexpr uint32_t VERSION = 3;
+
+    /**
+     * @brief Maps and validates a snapshot file.
+     * @throws std::runtime_error if the file is not a snapshot of this version or is corrupt.
+     */
+    explicit FibSnapshot(const std::filesystem::path& path);
+
+    /**
+     * @brief Writes a snapshot file. The file is replaced atomically.
+     * @throws std::runtime_error on I/O errors.
+     */
+    static void write(const std::filesystem::path& path, const FibSnapshotContents& contents);
+
+    const FibSnapshotContents& contents() const { return data; }
+
+    /** @brief The content hash as 16 hex digits. */
+    const std::string& hash() const { return hexHash; }
+
+   private:
+    FibSnapshotContents data;
+    std::string hexHash;
+};
+
+#endif  // FIBSNAPSHOT_H
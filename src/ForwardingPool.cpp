@@ -0,0 +1,113 @@
+#include "ForwardingPool.h"
+
+#include <spdlog/spdlog.h>
+
+#include <stdexcept>
+
+#include "protocol.h"
+#include "utils.h"
+
+ForwardingPool::ForwardingPool(StaticRouter& router, size_t workerCount, size_t queueDepth)
+    : router(router), queueDepth(queueDepth) {
+    if (workerCount == 0 || queueDepth == 0) {
+        throw std::invalid_argument("Forwarding pool needs at least one worker and a queue");
+    }
+
+    workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->queue.reserve(queueDepth);
+    }
+    // Start the threads once the vector no longer moves
+    for (auto& worker : workers) {
+        worker->thread = std::thread(&ForwardingPool::run, this, std::ref(*worker));
+    }
+
+    spdlog::info("Forwarding on {} worker threads.", workerCount);
+}
+
+ForwardingPool::~ForwardingPool() {
+    for (auto& worker : workers) {
+        {
+            std::lock_guard lock(worker->mutex);
+            worker->stop = true;
+        }
+        worker->ready.notify_one();
+    }
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+
+    if (uint64_t dropped = drops()) {
+        spdlog::warn("Forwarding workers dropped {} frames on full queues.", dropped);
+    }
+}
+
+void ForwardingPool::dispatch(Packet packet, const std::string& iface) {
+    bool ipv4 = packet.size() >= sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) &&
+                ntohs(reinterpret_cast<const sr_ethernet_hdr_t*>(packet.data())->ether_type) == ethertype_ip;
+    if (!ipv4) {
+        router.processPacket(std::move(packet), iface, dispatcherCache);
+        return;
+    }
+
+    // ECMP picks among next hops with the high bits of the same hash. Map only the low
+    // 16 bits onto the workers, so the worker says nothing about the next hop.
+    uint32_t hash = flow_hash(packet.data() + sizeof(sr_ethernet_hdr_t), packet.size() - sizeof(sr_ethernet_hdr_t));
+    Worker& worker = *workers[((hash & 0xFFFF) * workers.size()) >> 16];
+
+    bool wasEmpty;
+    {
+        std::lock_guard lock(worker.mutex);
+        if (worker.queue.size() >= queueDepth) {
+            worker.drops.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        worker.queue.push_back({std::move(packet), iface});
+        wasEmpty = worker.queue.size() == 1;
+    }
+    if (wasEmpty) {
+        worker.ready.notify_one();
+    }
+}
+
+uint64_t ForwardingPool::drops() const {
+    uint64_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker->drops.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+RouteCacheStats ForwardingPool::routeCacheStats() const {
+    RouteCacheStats total = dispatcherCache.stats();
+    for (const auto& worker : workers) {
+        total += worker->cache.stats();
+    }
+    return total;
+}
+
+void ForwardingPool::run(Worker& worker) {
+    std::vector<Frame> batch;
+    std::vector<PacketRef> refs;
+    batch.reserve(queueDepth);
+    refs.reserve(queueDepth);
+    while (true) {
+        {
+            std::unique_lock lock(worker.mutex);
+            worker.ready.wait(lock, [&] { return worker.stop || !worker.queue.empty(); });
+            if (worker.queue.empty()) {
+                return;  // Stopped, with nothing left to forward
+            }
+            // Take the whole queue and leave the emptied vector of the previous batch in its place
+            batch.swap(worker.queue);
+        }
+
+        for (Frame& frame : batch) {
+            refs.push_back({frame.packet, frame.iface});
+        }
+        router.processPackets(refs, worker.cache);
+        refs.clear();
+        batch.clear();
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef FORWARDINGPOOL_H
+#define FORWARDINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RouteCache.h"
+#include "RouterTypes.h"
+#include "StaticRouter.h"
+
+/**
+ * @class ForwardingPool
+ * @brief Spreads IPv4 forwarding over worker threads, RSS style.
+ *
+ * The dispatching thread hashes the addresses and ports of each IPv4 frame (see
+ * flow_hash()) to pick a worker, so every frame of a flow goes to the same worker and
+ * leaves in the order it arrived. Each worker drains its queue in batches and hands
+ * each batch to StaticRouter::processPackets() with a route cache of its own; nothing
+ * on that path takes a router-wide lock.
+ *
+ * ARP and other frames that are not IPv4 are handled on the dispatching thread right
+ * away, so a reply may overtake queued IPv4 frames. The ARP cache keeps such a flow in
+ * order: it sends the frames that waited for the reply before it publishes the entry, and
+ * a frame that missed the entry finds it again under the cache mutex instead of starting
+ * another request.
+ *
+ * Queues are bounded. When a worker falls behind, further frames for it are dropped
+ * and counted, like a full receive ring.
+ */
+class ForwardingPool {
+   public:
+    static constexpr size_t DEFAULT_QUEUE_DEPTH = 1024;
+
+    /**
+     * @param router Must outlive the pool.
+     * @param workerCount Number of worker threads, at least one.
+     * @param queueDepth Frames a worker may have waiting.
+     * @throws std::invalid_argument if workerCount or queueDepth is zero.
+     */
+    ForwardingPool(StaticRouter& router, size_t workerCount, size_t queueDepth = DEFAULT_QUEUE_DEPTH);
+
+    /**
+     * @brief Forwards the frames already queued, then stops the workers.
+     */
+    ~ForwardingPool();
+
+    ForwardingPool(const ForwardingPool&) = delete;
+    ForwardingPool& operator=(const ForwardingPool&) = delete;
+
+    /**
+     * @brief Hands a received frame to the worker of its flow. Called from a single
+     * dispatching thread.
+     */
+    void dispatch(Packet packet, const std::string& iface);
+
+    /** @brief Frames dropped so far because their worker's queue was full. */
+    uint64_t drops() const;
+
+    /** @brief Hits and misses of the route caches of every worker and the dispatching thread. */
+    RouteCacheStats routeCacheStats() const;
+
+   private:
+    /**
+     * @struct Frame
+     * @brief A received frame and the interface it came in on.
+     */
+    struct Frame {
+        Packet packet;
+        std::string iface;
+    };
+
+    /**
+     * @struct Worker
+     * @brief A forwarding thread and its queue. Aligned so workers share no cache line.
+     */
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::condition_variable ready; /**< Signalled when the queue stops being empty, or on shutdown. */
+        std::vector<Frame> queue;      /**< Guarded by mutex; swapped out whole by the worker. */
+        bool stop = false;             /**< Guarded by mutex. */
+        std::atomic<uint64_t> drops{0};
+        RouteCache cache; /**< Only used by the worker thread. */
+        std::thread thread;
+    };
+
+    void run(Worker& worker);
+
+    StaticRouter& router;
+    size_t queueDepth;
+    std::vector<std::unique_ptr<Worker>> workers;
+    RouteCache dispatcherCache; /**< For the frames handled on the dispatching thread. */
+};
+
+#endif  // FORWARDINGPOOL_H
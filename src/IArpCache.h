@@ -64,6 +64,14 @@ public:
    */
   virtual void queuePacket(uint32_t ip, const Packet &packet,
                            const std::string &iface) = 0;
+
+  /**
+   * @brief Like queuePacket() above, but takes the packet over instead of copying it.
+   */
+  virtual void queuePacket(uint32_t ip, Packet &&packet,
+                           const std::string &iface) {
+    queuePacket(ip, static_cast<const Packet &>(packet), iface);
+  }
 };
 
 #endif // IARPCACHE_H
@@ -1,6 +1,8 @@
 #ifndef PACKETSENDER_H
 #define PACKETSENDER_H
 
+#include <span>
+
 #include "RouterTypes.h"
 
 class IPacketSender {
@@ -13,6 +15,17 @@ class IPacketSender {
      * @param iface The interface on which to send the packet
      */
     virtual void sendPacket(Packet packet, const std::string& iface) = 0;
+
+    /**
+     * @brief Sends several packets on the same interface, in order
+     * @param packets The packets to send; they are moved from
+     * @param iface The interface on which to send them
+     */
+    virtual void sendPackets(std::span<Packet> packets, const std::string& iface) {
+        for (Packet& packet : packets) {
+            sendPacket(std::move(packet), iface);
+        }
+    }
 };
 
 #endif  // PACKETSENDER_H
@@ -7,6 +7,9 @@
 #include <unordered_map>
 #include <string>
 #include <optional>
+#include <span>
+
+#include "RouteCache.h"
 
 /**
  * @struct RoutingEntry
@@ -23,6 +26,22 @@ struct RoutingEntry
     std::string iface;  /**< The interface name associated with this route. */
 };
 
+/**
+ * @struct NextHop
+ * @brief A deduplicated (gateway, outgoing interface) pair that routes resolve to.
+ *
+ * Routes only store the index of their next hop, and interface names are interned
+ * to small integer IDs, so the forwarding path never handles strings.
+ */
+struct NextHop
+{
+    ip_addr gateway;   /**< The gateway IP address of the next hop. */
+    InterfaceId iface; /**< The interned ID of the outgoing interface. */
+};
+
+/** Returned by next hop lookups when no route matches. */
+inline constexpr uint32_t NO_NEXT_HOP = 0x00FFFFFF;
+
 /**
  * @struct RoutingInterface
  * @brief Represents a network interface in the routing table.
@@ -55,6 +74,69 @@ public:
      */
     virtual std::optional<RoutingEntry> getRoutingEntry(ip_addr ip) = 0;
 
+    /**
+     * @brief Finds the next hop for a specified IP address using longest prefix matching.
+     *
+     * This is the allocation-free form of getRoutingEntry() used on the forwarding path.
+     * Prefixes may have several equal-cost next hops; flowHash picks one of them, so
+     * packets of a flow must always pass the same hash (see flow_hash()).
+     * @param ip The IP address to find a route for.
+     * @param flowHash Selects among equal-cost next hops.
+     * @return The index of the next hop (see getNextHop()), or NO_NEXT_HOP.
+     */
+    virtual uint32_t lookupNextHop(ip_addr ip, uint32_t flowHash = 0) = 0;
+
+    /**
+     * @brief Like lookupNextHop(), but answers from a destination cache when it can and
+     * fills the cache otherwise.
+     *
+     * Cached results are dropped as soon as routes or interfaces change.
+     * @param cache The calling thread's own cache.
+     */
+    virtual uint32_t lookupNextHop(ip_addr ip, uint32_t flowHash, RouteCache& cache) = 0;
+
+    /**
+     * @brief Looks up the next hops of many IP addresses at once.
+     *
+     * Same result as calling lookupNextHop() for each address, with the memory accesses
+     * of neighbouring lookups overlapped.
+     * @param ips The IP addresses to find routes for.
+     * @param out Receives the next hop index for each address, or NO_NEXT_HOP.
+     * Must be at least as long as ips.
+     * @param flowHashes The flow hash of each address, or empty to use 0 for all.
+     */
+    virtual void lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out,
+                             std::span<const uint32_t> flowHashes = {}) = 0;
+
+    /**
+     * @brief Like lookupBatch(), but answers from a destination cache where it can; only
+     * the misses go to the FIB, still as one batch, and fill the cache.
+     * @param cache The calling thread's own cache.
+     */
+    virtual void lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out,
+                             std::span<const uint32_t> flowHashes, RouteCache& cache) = 0;
+
+    /**
+     * @brief Counts a packet routed to a next hop, to check how traffic spreads. Packets
+     * are counted when their route is chosen, including those that then wait for ARP
+     * resolution or are dropped because it fails.
+     * @param index A next hop index other than NO_NEXT_HOP.
+     * @param bytes The size of the packet.
+     */
+    virtual void countRouted(uint32_t index, size_t bytes) = 0;
+
+    /**
+     * @brief Retrieves a next hop returned by lookupNextHop() or lookupBatch().
+     * @param index A next hop index other than NO_NEXT_HOP.
+     */
+    virtual NextHop getNextHop(uint32_t index) = 0;
+
+    /**
+     * @brief Retrieves the name of an interned interface.
+     * @param id An interface ID taken from a NextHop.
+     */
+    virtual const std::string& getInterfaceName(InterfaceId id) = 0;
+
     /**
      * @brief Retrieves the routing interface for a specified interface name.
      * @param iface The name of the network interface.
@@ -72,9 +154,16 @@ public:
 
     /**
      * @brief Retrieves all network interfaces in the routing table.
-     * @return A map of interface names to routing interfaces.
+     * @return A copy of the current map of interface names to routing interfaces.
+     */
+    virtual std::unordered_map<std::string, RoutingInterface> getRoutingInterfaces() const = 0;
+
+    /**
+     * @brief Checks whether an address belongs to one of the router's interfaces.
+     * @param ip The address to check, in network byte order.
+     * @return True if some interface has this address.
      */
-    virtual const std::unordered_map<std::string, RoutingInterface>& getRoutingInterfaces() const = 0;
+    virtual bool isInterfaceAddress(ip_addr ip) const = 0;
 };
 
 #endif //IROUTINGTABLE_H
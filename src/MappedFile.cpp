@@ -0,0 +1,44 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+MappedFile::MappedFile(const std::filesystem::path& path, bool writable) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Failed to stat " + path.string() + ": " + std::strerror(error));
+    }
+
+    length = info.st_size;
+    if (length > 0) {
+        int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        data = mmap(nullptr, length, protection, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error("Failed to map " + path.string() + ": " + std::strerror(error));
+        }
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(data, length);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+/**
+ * @class MappedFile
+ * @brief A file mapped into memory for the lifetime of the object.
+ *
+ * The mapping is private: writes (if requested) go to copy-on-write pages of this
+ * process and never reach the file.
+ */
+class MappedFile {
+   public:
+    /**
+     * @param path The file to map.
+     * @param writable Whether the mapped pages may be modified in memory.
+     * @throws std::runtime_error if the file cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::filesystem::path& path, bool writable = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<std::byte> bytes() const { return {static_cast<std::byte*>(data), length}; }
+
+    size_t size() const { return length; }
+
+   private:
+    void* data = nullptr;
+    size_t length = 0;
+};
+
+#endif  // MAPPEDFILE_H
@@ -0,0 +1,120 @@
+#include "NeighborSnapshot.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "MappedFile.h"
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC = {'S', 'R', 'A', 'R', 'P', 'S', 'N', 'P'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t count;
+    int64_t savedAt; /**< Seconds since the Unix epoch. */
+};
+
+struct Record {
+    ip_addr ip;
+    std::array<uint8_t, 6> mac;
+    uint16_t reserved;
+};
+static_assert(sizeof(Record) == 12);
+
+// Writes the whole buffer, resuming after short writes and interruptions
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* pos = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, pos, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        pos += written;
+        size -= written;
+    }
+    return true;
+}
+
+}  // namespace
+
+void writeNeighborSnapshot(const std::filesystem::path& path, const std::vector<NeighborRecord>& neighbors) {
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.count = neighbors.size();
+    header.savedAt = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::vector<Record> records(neighbors.size());
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+        records[i] = {neighbors[i].ip, neighbors[i].mac, 0};
+    }
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create " + temporary.string() + ": " + std::strerror(errno));
+    }
+    // The data must be on disk before the rename, or a crash could leave an empty snapshot behind
+    bool written = writeAll(fd, &header, sizeof(header)) &&
+                   writeAll(fd, records.data(), records.size() * sizeof(Record)) && fsync(fd) == 0;
+    int error = errno;
+    if (close(fd) != 0 && written) {
+        written = false;
+        error = errno;
+    }
+    if (!written) {
+        throw std::runtime_error("Failed to write " + temporary.string() + ": " + std::strerror(error));
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+NeighborSnapshotContents readNeighborSnapshot(const std::filesystem::path& path) {
+    MappedFile file(path);
+    std::span<std::byte> bytes = file.bytes();
+
+    Header header;
+    if (bytes.size() < sizeof(Header)) {
+        throw std::runtime_error(path.string() + " is not a neighbor snapshot");
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != MAGIC) {
+        throw std::runtime_error(path.string() + " is not a neighbor snapshot");
+    }
+    if (header.byteOrder != BYTE_ORDER_MARK) {
+        throw std::runtime_error(path.string() + " was written on a machine with a different byte order");
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error(path.string() + " has snapshot version " + std::to_string(header.version) +
+                                 ", expected " + std::to_string(VERSION));
+    }
+    if (header.count > bytes.size() / sizeof(Record) || bytes.size() - sizeof(Header) != header.count * sizeof(Record)) {
+        throw std::runtime_error(path.string() + " is corrupt (bad record count)");
+    }
+
+    NeighborSnapshotContents contents;
+    contents.savedAt = std::chrono::system_clock::time_point(std::chrono::seconds(header.savedAt));
+    contents.neighbors.reserve(header.count);
+    for (size_t i = 0; i < header.count; ++i) {
+        Record record;
+        std::memcpy(&record, bytes.data() + sizeof(Header) + i * sizeof(Record), sizeof(record));
+        contents.neighbors.push_back({record.ip, record.mac});
+    }
+    return contents;
+}
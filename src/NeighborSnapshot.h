@@ -0,0 +1,44 @@
+#ifndef NEIGHBORSNAPSHOT_H
+#define NEIGHBORSNAPSHOT_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "RouterTypes.h"
+
+/**
+ * @struct NeighborRecord
+ * @brief A resolved neighbor as saved across restarts.
+ */
+struct NeighborRecord {
+    ip_addr ip;
+    mac_addr mac;
+};
+
+/**
+ * @struct NeighborSnapshotContents
+ * @brief The neighbors of an ARP cache and when they were saved.
+ */
+struct NeighborSnapshotContents {
+    std::chrono::system_clock::time_point savedAt;
+    std::vector<NeighborRecord> neighbors;
+};
+
+/**
+ * @brief Writes the neighbors of an ARP cache to a file, replacing it atomically.
+ *
+ * Layout: a fixed header (magic, format version, byte order mark, record count and
+ * save time) followed by fixed-size records in host byte order.
+ * @throws std::runtime_error on I/O errors.
+ */
+void writeNeighborSnapshot(const std::filesystem::path& path, const std::vector<NeighborRecord>& neighbors);
+
+/**
+ * @brief Reads a file written by writeNeighborSnapshot().
+ * @throws std::runtime_error if the file is missing, of another version or corrupt.
+ */
+NeighborSnapshotContents readNeighborSnapshot(const std::filesystem::path& path);
+
+#endif  // NEIGHBORSNAPSHOT_H
@@ -0,0 +1,273 @@
+#include "NeighborTable.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+uint32_t macLowOf(const mac_addr& mac) {
+    uint32_t bits;
+    std::memcpy(&bits, mac.data(), sizeof(bits));
+    return bits;
+}
+
+uint16_t macHighOf(const mac_addr& mac) {
+    uint16_t bits;
+    std::memcpy(&bits, mac.data() + 4, sizeof(bits));
+    return bits;
+}
+
+}  // namespace
+
+NeighborTable::NeighborTable(size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity > MAX_CAPACITY) {
+        throw std::invalid_argument("Neighbor table capacity must be a power of two up to 2^24");
+    }
+    slots.reset(new Slot[capacity]);
+    notes.reset(new uint64_t[capacity]());
+    mask = capacity - 1;
+}
+
+std::optional<mac_addr> NeighborTable::find(ip_addr ip) const {
+    while (true) {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        // The slots may change under us; the probe is bounded and its result only
+        // trusted if no write happened meanwhile
+        const Slot* found = nullptr;
+        uint32_t low = 0;
+        uint16_t high = 0;
+        size_t index = home(ip);
+        for (size_t distance = 0; distance <= MAX_DISTANCE; ++distance, index = (index + 1) & mask) {
+            const Slot& slot = slots[index];
+            ip_addr slotIp = slot.ip.load(std::memory_order_relaxed);
+            if (slotIp == ip) {
+                found = &slot;
+                low = slot.macLow.load(std::memory_order_relaxed);
+                high = slot.macHigh.load(std::memory_order_relaxed);
+                break;
+            }
+            // Robin Hood order: the key would have displaced an entry this close to home
+            if (slotIp == 0 || slot.distance.load(std::memory_order_relaxed) < distance) {
+                break;
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        if (!found) {
+            return std::nullopt;
+        }
+
+        // Only written when a flag is clear, so hot entries do not keep dirtying their cache
+        // line. A concurrent move may flag a neighbouring entry instead, which only costs accuracy.
+        if (found->usage.load(std::memory_order_relaxed) != (REFERENCED | USED)) {
+            found->usage.store(REFERENCED | USED, std::memory_order_relaxed);
+        }
+        mac_addr mac;
+        std::memcpy(mac.data(), &low, sizeof(low));
+        std::memcpy(mac.data() + 4, &high, sizeof(high));
+        return mac;
+    }
+}
+
+std::optional<mac_addr> NeighborTable::macOf(ip_addr ip) const {
+    size_t index = locate(ip);
+    if (index == capacity()) {
+        return std::nullopt;
+    }
+    return macAt(index);
+}
+
+std::optional<uint64_t> NeighborTable::noteOf(ip_addr ip) const {
+    size_t index = locate(ip);
+    if (index == capacity()) {
+        return std::nullopt;
+    }
+    return notes[index];
+}
+
+bool NeighborTable::setNote(ip_addr ip, uint64_t note) {
+    size_t index = locate(ip);
+    if (index == capacity()) {
+        return false;
+    }
+    // Readers never look at notes, so no write section is needed
+    notes[index] = note;
+    return true;
+}
+
+std::optional<uint32_t> NeighborTable::stampOf(ip_addr ip) const {
+    size_t index = locate(ip);
+    if (index == capacity()) {
+        return std::nullopt;
+    }
+    return slots[index].stamp.load(std::memory_order_relaxed);
+}
+
+bool NeighborTable::takeUsed(ip_addr ip) {
+    size_t index = locate(ip);
+    if (index == capacity()) {
+        return false;
+    }
+    return slots[index].usage.fetch_and(~USED, std::memory_order_relaxed) & USED;
+}
+
+bool NeighborTable::insert(ip_addr ip, const mac_addr& mac, uint32_t stamp, uint64_t note) {
+    if (ip == 0) {
+        return false;
+    }
+
+    beginWrite();
+    size_t index = locate(ip);
+    if (index != capacity()) {
+        Slot& slot = slots[index];
+        slot.macLow.store(macLowOf(mac), std::memory_order_relaxed);
+        slot.macHigh.store(macHighOf(mac), std::memory_order_relaxed);
+        slot.stamp.store(stamp, std::memory_order_relaxed);
+        slot.usage.fetch_or(REFERENCED, std::memory_order_relaxed);
+        notes[index] = note;
+    } else {
+        if ((count + 1) * 8 > capacity() * 7) {
+            evictOne();
+        }
+        // New entries get a full sweep before they can be evicted
+        Entry entry{ip, macLowOf(mac), macHighOf(mac), stamp, REFERENCED, note};
+        while (!place(entry)) {
+            // A probe sequence this long means a pathological hash distribution. The
+            // entry left over may be one the newcomer displaced, so make room for it.
+            evictOne();
+        }
+    }
+    endWrite();
+    return true;
+}
+
+bool NeighborTable::erase(ip_addr ip) {
+    size_t index = ip == 0 ? capacity() : locate(ip);
+    if (index == capacity()) {
+        return false;
+    }
+
+    beginWrite();
+    removeAt(index);
+    endWrite();
+    return true;
+}
+
+size_t NeighborTable::locate(ip_addr ip) const {
+    size_t index = home(ip);
+    for (size_t distance = 0; distance <= MAX_DISTANCE; ++distance, index = (index + 1) & mask) {
+        ip_addr slotIp = slots[index].ip.load(std::memory_order_relaxed);
+        if (slotIp == ip) {
+            return index;
+        }
+        if (slotIp == 0 || slots[index].distance.load(std::memory_order_relaxed) < distance) {
+            break;
+        }
+    }
+    return capacity();
+}
+
+mac_addr NeighborTable::macAt(size_t index) const {
+    uint32_t low = slots[index].macLow.load(std::memory_order_relaxed);
+    uint16_t high = slots[index].macHigh.load(std::memory_order_relaxed);
+    mac_addr mac;
+    std::memcpy(mac.data(), &low, sizeof(low));
+    std::memcpy(mac.data() + 4, &high, sizeof(high));
+    return mac;
+}
+
+bool NeighborTable::place(Entry& entry) {
+    size_t index = home(entry.ip);
+    for (size_t distance = 0; distance <= MAX_DISTANCE; ++distance, index = (index + 1) & mask) {
+        Slot& slot = slots[index];
+        ip_addr slotIp = slot.ip.load(std::memory_order_relaxed);
+        size_t slotDistance = slot.distance.load(std::memory_order_relaxed);
+        if (slotIp != 0 && slotDistance >= distance) {
+            continue;
+        }
+
+        // Take the slot; an entry closer to its home moves on in our place
+        Entry displaced{slotIp,
+                        slot.macLow.load(std::memory_order_relaxed),
+                        slot.macHigh.load(std::memory_order_relaxed),
+                        slot.stamp.load(std::memory_order_relaxed),
+                        slot.usage.load(std::memory_order_relaxed),
+                        notes[index]};
+
+        slot.ip.store(entry.ip, std::memory_order_relaxed);
+        slot.macLow.store(entry.macLow, std::memory_order_relaxed);
+        slot.macHigh.store(entry.macHigh, std::memory_order_relaxed);
+        slot.stamp.store(entry.stamp, std::memory_order_relaxed);
+        slot.distance.store(distance, std::memory_order_relaxed);
+        slot.usage.store(entry.usage, std::memory_order_relaxed);
+        notes[index] = entry.note;
+
+        if (displaced.ip == 0) {
+            ++count;
+            return true;
+        }
+        entry = displaced;
+        distance = slotDistance;
+    }
+    return false;
+}
+
+void NeighborTable::removeAt(size_t index) {
+    // Pull back every following entry that is not in its home slot
+    size_t hole = index;
+    for (size_t next = (hole + 1) & mask;; next = (next + 1) & mask) {
+        Slot& from = slots[next];
+        if (from.ip.load(std::memory_order_relaxed) == 0 || from.distance.load(std::memory_order_relaxed) == 0) {
+            break;
+        }
+        Slot& to = slots[hole];
+        to.ip.store(from.ip.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.macLow.store(from.macLow.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.macHigh.store(from.macHigh.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.stamp.store(from.stamp.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.distance.store(from.distance.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        to.usage.store(from.usage.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        notes[hole] = notes[next];
+        hole = next;
+    }
+    slots[hole].ip.store(0, std::memory_order_relaxed);
+    slots[hole].distance.store(0, std::memory_order_relaxed);
+    --count;
+}
+
+void NeighborTable::evictOne() {
+    // Two sweeps clear every flag, so the second one always finds a victim
+    for (size_t step = 0; step < 2 * capacity(); ++step) {
+        size_t index = hand;
+        hand = (hand + 1) & mask;
+
+        Slot& slot = slots[index];
+        if (slot.ip.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        if (slot.usage.load(std::memory_order_relaxed) & REFERENCED) {
+            slot.usage.fetch_and(~REFERENCED, std::memory_order_relaxed);
+            continue;
+        }
+        removeAt(index);
+        ++evicted;
+        return;
+    }
+}
+
+void NeighborTable::beginWrite() {
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    // Keeps the slot stores that follow from becoming visible before the odd count
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void NeighborTable::endWrite() {
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,184 @@
+#ifndef NEIGHBORTABLE_H
+#define NEIGHBORTABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "RouterTypes.h"
+
+/**
+ * @class NeighborTable
+ * @brief IP to MAC address map for the forwarding path, readable without locks.
+ *
+ * A flat Robin Hood hash table of 16-byte slots, four to a cache line, so that a
+ * subnet of tens of thousands of hosts costs a few megabytes and a lookup typically
+ * touches one line. Every entry records how far it sits from its home slot; inserts
+ * displace entries that are closer to home than the one being placed, which keeps
+ * probe sequences short and lets lookups stop as soon as they pass the distance the
+ * key would have. Removal shifts the following entries back instead of leaving
+ * tombstones.
+ *
+ * The array is protected by a single sequence counter (a seqlock). A writer makes the
+ * counter odd, changes the slots and makes it even again; a reader probes the array
+ * and retries if the counter moved meanwhile. Readers therefore never block, and never
+ * observe the intermediate states of a displacement or shift.
+ *
+ * The capacity is fixed. Once seven eighths of the slots are used, each insert evicts
+ * an entry chosen by the CLOCK algorithm: a hand sweeps the slots, clearing the
+ * referenced flag that lookups set, and evicts the first entry whose flag is already
+ * clear. A second flag, set by the same lookups, tells the owner whether an entry is
+ * still in use. Writers must be serialized by the caller.
+ *
+ * Each entry also carries a note for the owner's bookkeeping. Notes live in an array
+ * parallel to the slots that readers never touch, and move together with their entry.
+ */
+class NeighborTable {
+   public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+    static constexpr size_t MAX_CAPACITY = size_t{1} << 24; /**< The hash provides 24 bits. */
+
+    /**
+     * @param capacity Number of slots, a power of two.
+     * @throws std::invalid_argument if capacity is out of range.
+     */
+    explicit NeighborTable(size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Returns the MAC address of a neighbor and marks it as recently used.
+     * Lock-free; safe to call concurrently with a writer.
+     */
+    std::optional<mac_addr> find(ip_addr ip) const;
+
+    /**
+     * @brief Returns the stamp stored with a neighbor. For writers only.
+     */
+    std::optional<uint32_t> stampOf(ip_addr ip) const;
+
+    /**
+     * @brief Returns the MAC address of a neighbor without marking it as used. For
+     * writers only.
+     */
+    std::optional<mac_addr> macOf(ip_addr ip) const;
+
+    /**
+     * @brief Returns the note stored with a neighbor. For writers only.
+     */
+    std::optional<uint64_t> noteOf(ip_addr ip) const;
+
+    /**
+     * @brief Replaces the note of a neighbor. For writers only.
+     * @return Whether the neighbor was present.
+     */
+    bool setNote(ip_addr ip, uint64_t note);
+
+    /**
+     * @brief Returns whether a neighbor was looked up since the previous call, and
+     * starts over. For writers only; independent of the eviction order.
+     */
+    bool takeUsed(ip_addr ip);
+
+    /**
+     * @brief Adds a neighbor, or changes its MAC address, stamp and note, evicting the
+     * least recently used neighbor if the table is full. Entries that collide into a
+     * probe sequence longer than MAX_DISTANCE also make room by eviction; no entry is
+     * lost any other way.
+     * @param stamp An opaque value kept with the entry, such as the time it was resolved.
+     * @param note An opaque value for the writer only, such as the state of the entry.
+     * @return False if the address is 0.0.0.0, which cannot be stored.
+     */
+    bool insert(ip_addr ip, const mac_addr& mac, uint32_t stamp, uint64_t note = 0);
+
+    /**
+     * @brief Removes a neighbor.
+     * @return Whether the neighbor was present.
+     */
+    bool erase(ip_addr ip);
+
+    size_t size() const { return count; }
+
+    size_t capacity() const { return mask + 1; }
+
+    /** @brief The number of neighbors evicted to make room for new ones. */
+    uint64_t evictions() const { return evicted; }
+
+    /**
+     * @brief Calls fn(ip, mac) for every neighbor, in slot order. For writers only.
+     */
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i <= mask; ++i) {
+            ip_addr ip = slots[i].ip.load(std::memory_order_relaxed);
+            if (ip != 0) {
+                fn(ip, macAt(i));
+            }
+        }
+    }
+
+   private:
+    /**
+     * @struct Slot
+     * @brief One entry in 16 bytes. An empty slot holds address 0, never a neighbor.
+     */
+    struct Slot {
+        std::atomic<ip_addr> ip{0};
+        std::atomic<uint32_t> stamp{0};
+        std::atomic<uint32_t> macLow{0};  /**< MAC bytes 0-3. */
+        std::atomic<uint16_t> macHigh{0}; /**< MAC bytes 4-5. */
+        std::atomic<uint8_t> distance{0}; /**< Slots between the entry and its home slot. */
+        mutable std::atomic<uint8_t> usage{0}; /**< REFERENCED and USED, set together by lookups. */
+    };
+    static_assert(sizeof(Slot) == 16);
+
+    /**
+     * @struct Entry
+     * @brief The contents of a slot while it is carried to a new place.
+     */
+    struct Entry {
+        ip_addr ip;
+        uint32_t macLow;
+        uint16_t macHigh;
+        uint32_t stamp;
+        uint8_t usage;
+        uint64_t note;
+    };
+
+    static constexpr uint8_t MAX_DISTANCE = UINT8_MAX;
+    static constexpr uint8_t REFERENCED = 1; /**< Cleared by the CLOCK hand. */
+    static constexpr uint8_t USED = 2;       /**< Cleared by takeUsed(). */
+
+    size_t home(ip_addr ip) const { return ((ip * 0x9E3779B97F4A7C15ull) >> 40) & mask; }
+
+    /** @return The index of the slot holding ip, or capacity() if there is none. */
+    size_t locate(ip_addr ip) const;
+
+    mac_addr macAt(size_t index) const;
+
+    /**
+     * @brief Places a new entry, displacing entries closer to their home. Inside a write.
+     * @return False if an entry would end up more than MAX_DISTANCE from its home. That
+     * entry, the new one or one it displaced, is left in entry and still has to be placed.
+     */
+    bool place(Entry& entry);
+
+    /** @brief Empties a slot and shifts the entries that follow it back. Inside a write. */
+    void removeAt(size_t index);
+
+    /** @brief Evicts one entry chosen by the CLOCK hand. Inside a write. */
+    void evictOne();
+
+    void beginWrite();
+
+    void endWrite();
+
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<uint64_t[]> notes; /**< Parallel to slots. */
+    size_t mask;
+    size_t count = 0;
+    size_t hand = 0; /**< Next slot the CLOCK hand looks at. */
+    uint64_t evicted = 0;
+    alignas(64) std::atomic<uint64_t> sequence{0}; /**< Odd while a write is in progress. */
+};
+
+#endif  // NEIGHBORTABLE_H
@@ -0,0 +1,100 @@
+#include "PendingPacketPool.h"
+
+#include <stdexcept>
+#include <utility>
+
+QueueDropPolicy parseQueueDropPolicy(const std::string& name) {
+    if (name == "tail") {
+        return QueueDropPolicy::Tail;
+    }
+    if (name == "head") {
+        return QueueDropPolicy::Head;
+    }
+    throw std::invalid_argument("Unknown queue drop policy: " + name);
+}
+
+PendingPacketPool::PendingPacketPool(const PendingPacketLimits& limits) : caps(limits), nodes(limits.packets) {
+    if (limits.packets >= NONE) {
+        throw std::invalid_argument("Too many pending packets");
+    }
+    for (size_t i = nodes.size(); i-- > 0;) {
+        nodes[i].next = freeList;
+        freeList = i;
+    }
+}
+
+bool PendingPacketPool::push(Queue& queue, Packet& packet, const std::string& iface) {
+    size_t size = packet.size();
+    auto fits = [&] {
+        return queue.packets < caps.packetsPerQueue && queue.bytes + size <= caps.bytesPerQueue &&
+               freeList != NONE && counters.bytes + size <= caps.bytes;
+    };
+
+    // Head drop only makes room within the queue itself; other next hops keep their packets.
+    // A packet that would not fit even into the emptied queue leaves it untouched.
+    bool fitsOnceEmptied = caps.packetsPerQueue > 0 && size <= caps.bytesPerQueue &&
+                           (freeList != NONE || queue.head != NONE) && counters.bytes - queue.bytes + size <= caps.bytes;
+    if (caps.policy == QueueDropPolicy::Head && fitsOnceEmptied) {
+        while (!fits() && queue.head != NONE) {
+            dropHead(queue);
+        }
+    }
+    if (!fits()) {
+        ++counters.tailDrops;
+        counters.droppedBytes += size;
+        return false;
+    }
+
+    uint32_t index = freeList;
+    Node& node = nodes[index];
+    freeList = node.next;
+
+    node.packet = std::move(packet);
+    node.iface = iface;
+    node.size = size;
+    node.next = NONE;
+
+    if (queue.tail == NONE) {
+        queue.head = index;
+    } else {
+        nodes[queue.tail].next = index;
+    }
+    queue.tail = index;
+    ++queue.packets;
+    queue.bytes += size;
+    ++counters.packets;
+    counters.bytes += size;
+    return true;
+}
+
+void PendingPacketPool::release(Queue& queue) {
+    while (queue.head != NONE) {
+        popHead(queue);
+    }
+}
+
+void PendingPacketPool::popHead(Queue& queue) {
+    uint32_t index = queue.head;
+    Node& node = nodes[index];
+    size_t size = node.size;
+
+    queue.head = node.next;
+    if (queue.head == NONE) {
+        queue.tail = NONE;
+    }
+    --queue.packets;
+    queue.bytes -= size;
+    --counters.packets;
+    counters.bytes -= size;
+
+    // drain() callbacks usually moved the packet out already; a dropped one is freed here
+    Packet().swap(node.packet);
+    node.next = freeList;
+    freeList = index;
+}
+
+void PendingPacketPool::dropHead(Queue& queue) {
+    ++counters.headDrops;
+    counters.droppedBytes += nodes[queue.head].size;
+    popHead(queue);
+}
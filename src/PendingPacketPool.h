@@ -0,0 +1,129 @@
+#ifndef PENDINGPACKETPOOL_H
+#define PENDINGPACKETPOOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RouterTypes.h"
+
+/**
+ * @enum QueueDropPolicy
+ * @brief Which packet is dropped when a full queue receives another one.
+ */
+enum class QueueDropPolicy {
+    Tail, /**< Drop the arriving packet. */
+    Head  /**< Drop the oldest packets of the same queue to make room. */
+};
+
+/**
+ * @brief Parses a drop policy as given on the command line ("tail" or "head").
+ * @throws std::invalid_argument if the name is unknown.
+ */
+QueueDropPolicy parseQueueDropPolicy(const std::string& name);
+
+/**
+ * @struct PendingPacketLimits
+ * @brief Caps on the packets waiting for address resolution.
+ */
+struct PendingPacketLimits {
+    size_t packetsPerQueue = 64;         /**< Packets waiting for one next hop. */
+    size_t bytesPerQueue = 64 * 1024;    /**< Bytes waiting for one next hop. */
+    size_t packets = 4096;               /**< Packets waiting overall; the pool's preallocated size. */
+    size_t bytes = 4 * 1024 * 1024;      /**< Bytes waiting overall. */
+    QueueDropPolicy policy = QueueDropPolicy::Tail;
+};
+
+/**
+ * @struct PendingPacketStats
+ * @brief What is queued right now and what was dropped so far.
+ */
+struct PendingPacketStats {
+    uint64_t packets = 0;      /**< Packets currently queued. */
+    uint64_t bytes = 0;        /**< Bytes currently queued. */
+    uint64_t tailDrops = 0;    /**< Arriving packets dropped because a cap was reached. */
+    uint64_t headDrops = 0;    /**< Queued packets dropped to make room for newer ones. */
+    uint64_t droppedBytes = 0; /**< Bytes of both kinds of drops. */
+};
+
+/**
+ * @class PendingPacketPool
+ * @brief Packets waiting for address resolution, in per-next-hop FIFO queues drawn
+ * from one preallocated node arena.
+ *
+ * Queues are singly linked lists of node indices, so queueing and dequeueing never
+ * allocate nodes. The packet bytes are not pooled: each packet keeps its own buffer,
+ * which is moved into the node and moved out again when the queue is drained, and
+ * freed when the packet is dropped or released. Every push is checked against the
+ * per-queue and overall caps, and the configured policy decides what gets dropped.
+ *
+ * Not synchronized; the owner serializes access.
+ */
+class PendingPacketPool {
+   public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /**
+     * @struct Queue
+     * @brief The packets waiting for one next hop. Owned by the caller, which must
+     * release() it before dropping it.
+     */
+    struct Queue {
+        uint32_t head = NONE;
+        uint32_t tail = NONE;
+        uint32_t packets = 0;
+        size_t bytes = 0;
+    };
+
+    explicit PendingPacketPool(const PendingPacketLimits& limits = {});
+
+    /**
+     * @brief Appends a packet to a queue, dropping packets as the caps and policy dictate.
+     * @param packet Moved from if it was queued; left as is if it was dropped.
+     * @return Whether the packet was queued.
+     */
+    bool push(Queue& queue, Packet& packet, const std::string& iface);
+
+    /**
+     * @brief Removes every packet from a queue in arrival order, passing each to
+     * fn(Packet&, const std::string& iface) before its node is reused.
+     */
+    template <typename Fn>
+    void drain(Queue& queue, Fn&& fn) {
+        while (queue.head != NONE) {
+            Node& node = nodes[queue.head];
+            fn(node.packet, node.iface);
+            popHead(queue);
+        }
+    }
+
+    /**
+     * @brief Discards every packet in a queue without counting them as drops.
+     */
+    void release(Queue& queue);
+
+    PendingPacketStats stats() const { return counters; }
+
+    const PendingPacketLimits& limits() const { return caps; }
+
+   private:
+    struct Node {
+        Packet packet;
+        std::string iface;
+        size_t size = 0; /**< Queued length; drain() callbacks may move the packet out. */
+        uint32_t next = NONE;
+    };
+
+    /** @brief Unlinks the oldest packet of a queue and frees its buffer. */
+    void popHead(Queue& queue);
+
+    /** @brief Drops the oldest packet of a queue and counts it. */
+    void dropHead(Queue& queue);
+
+    PendingPacketLimits caps;
+    std::vector<Node> nodes;
+    uint32_t freeList = NONE;
+    PendingPacketStats counters;
+};
+
+#endif  // PENDINGPACKETPOOL_H
@@ -0,0 +1,128 @@
+#include "Rcu.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace rcu {
+
+namespace {
+
+constexpr size_t MAX_READER_THREADS = 256;
+
+/**
+ * Epoch observed by a reader when it entered its outermost guard, or 0 while idle.
+ * Each slot sits on its own cache line so readers do not contend with each other.
+ */
+struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> claimed{false};
+};
+
+struct Retired {
+    uint64_t epoch;                /**< Value of globalEpoch when the object was retired. */
+    std::function<void()> reclaim;
+};
+
+std::array<ReaderSlot, MAX_READER_THREADS> slots;
+std::atomic<uint64_t> globalEpoch{1};
+
+std::mutex retiredMutex;
+std::vector<Retired> retired;
+
+struct ThreadState {
+    ReaderSlot* slot = nullptr;
+    unsigned nesting = 0;
+
+    ~ThreadState() {
+        if (slot) {
+            slot->claimed.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadState threadState;
+
+ReaderSlot* claimSlot() {
+    for (auto& slot : slots) {
+        bool expected = false;
+        if (slot.claimed.compare_exchange_strong(expected, true)) {
+            return &slot;
+        }
+    }
+    throw std::runtime_error("Too many RCU reader threads");
+}
+
+// Runs every reclamation whose grace period is over. Called with retiredMutex held,
+// which it releases before running them.
+void reclaimExpired(std::unique_lock<std::mutex>& lock) {
+    // A reader that entered at epoch e may hold anything retired at epoch >= e
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (const auto& slot : slots) {
+        uint64_t epoch = slot.epoch.load();
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    std::vector<std::function<void()>> expired;
+    std::erase_if(retired, [&](Retired& item) {
+        if (item.epoch < oldest) {
+            expired.push_back(std::move(item.reclaim));
+            return true;
+        }
+        return false;
+    });
+
+    lock.unlock();
+    for (auto& reclaim : expired) {
+        reclaim();
+    }
+}
+
+}  // namespace
+
+ReadGuard::ReadGuard() {
+    ThreadState& state = threadState;
+    if (state.nesting++ == 0) {
+        if (!state.slot) {
+            state.slot = claimSlot();
+        }
+        // Sequentially consistent so that the pointer loads that follow cannot be
+        // reordered before the slot is visible to writers
+        state.slot->epoch.store(globalEpoch.load());
+    }
+}
+
+ReadGuard::~ReadGuard() {
+    ThreadState& state = threadState;
+    if (--state.nesting == 0) {
+        state.slot->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void retire(std::function<void()> reclaim) {
+    std::unique_lock lock(retiredMutex);
+    // Readers that enter from now on observe a later epoch and cannot see the object
+    uint64_t epoch = globalEpoch.fetch_add(1);
+    retired.push_back({epoch, std::move(reclaim)});
+    reclaimExpired(lock);
+}
+
+void synchronize() {
+    while (true) {
+        std::unique_lock lock(retiredMutex);
+        if (retired.empty()) {
+            return;
+        }
+        reclaimExpired(lock);
+        std::this_thread::yield();
+    }
+}
+
+}  // namespace rcu
@@ -0,0 +1,55 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <functional>
+
+/**
+ * Epoch-based read-copy-update.
+ *
+ * Readers wrap their accesses to shared objects in a ReadGuard. Entering and leaving
+ * a guard are a couple of atomic stores to a per-thread slot, so readers never block
+ * and never wait for writers. Writers publish a replacement with a single atomic
+ * pointer store and hand the old object to retire(); it is destroyed once every
+ * reader that could still see it has left its guard.
+ */
+namespace rcu {
+
+/**
+ * @class ReadGuard
+ * @brief Marks the current thread as reading RCU-protected objects for its lifetime.
+ *
+ * Guards may be nested. Pointers loaded inside a guard must not be used after it ends.
+ */
+class ReadGuard {
+   public:
+    ReadGuard();
+    ~ReadGuard();
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+};
+
+/**
+ * @brief Defers a reclamation until no reader can hold a reference to the retired object.
+ *
+ * Must be called after the object has been unpublished. Reclamations whose grace
+ * period has already elapsed run on the calling thread before this returns.
+ */
+void retire(std::function<void()> reclaim);
+
+/**
+ * @brief Retires an object allocated with new.
+ */
+template <typename T>
+void retire(T* object) {
+    retire([object] { delete object; });
+}
+
+/**
+ * @brief Waits for every pending reclamation to run. Must not be called inside a ReadGuard.
+ */
+void synchronize();
+
+}  // namespace rcu
+
+#endif  // RCU_H
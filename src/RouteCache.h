@@ -0,0 +1,107 @@
+#ifndef ROUTECACHE_H
+#define ROUTECACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "RouterTypes.h"
+
+/**
+ * @struct RouteCacheStats
+ * @brief Hits and misses of one or more route caches.
+ */
+struct RouteCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    RouteCacheStats& operator+=(const RouteCacheStats& other) {
+        hits += other.hits;
+        misses += other.misses;
+        return *this;
+    }
+};
+
+/**
+ * @class RouteCache
+ * @brief A direct-mapped cache from destination address to the FIB value of its route.
+ *
+ * Each destination hashes to exactly one slot; a miss overwrites whatever was there.
+ * Slots are tagged with the routing table generation they were filled in, and a
+ * lookup only hits if that generation is still current, so bumping the generation
+ * invalidates the whole cache at once without touching it.
+ *
+ * A cache belongs to a single forwarding thread and is not synchronized. The hit and
+ * miss counters may be read from other threads.
+ */
+class RouteCache {
+   public:
+    static constexpr size_t DEFAULT_SLOTS = 4096;
+    static constexpr size_t MAX_SLOTS = size_t{1} << 24; /**< The hash provides 24 bits. */
+
+    /**
+     * @param slots Number of cached destinations, a power of two.
+     * @throws std::invalid_argument if slots is out of range.
+     */
+    explicit RouteCache(size_t slots = DEFAULT_SLOTS) : lines((slots + SLOTS_PER_LINE - 1) / SLOTS_PER_LINE) {
+        if (slots == 0 || (slots & (slots - 1)) != 0 || slots > MAX_SLOTS) {
+            throw std::invalid_argument("Route cache size must be a power of two up to 2^24");
+        }
+        slotMask = slots - 1;
+    }
+
+    /**
+     * @brief Returns the cached FIB value for a destination if it was stored in the
+     * given generation.
+     */
+    std::optional<uint32_t> find(ip_addr ip, uint64_t generation) {
+        const Slot& slot = slotFor(ip);
+        if (slot.generation == generation && slot.ip == ip) {
+            hitCount.store(hitCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return slot.value;
+        }
+        missCount.store(missCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Caches the FIB value looked up for a destination in the given generation.
+     */
+    void insert(ip_addr ip, uint64_t generation, uint32_t value) { slotFor(ip) = {generation, ip, value}; }
+
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+
+    RouteCacheStats stats() const { return {hits(), misses()}; }
+
+   private:
+    struct Slot {
+        uint64_t generation = 0; /**< Never a valid generation, so empty slots always miss. */
+        ip_addr ip = 0;
+        uint32_t value = 0;
+    };
+
+    static constexpr size_t SLOTS_PER_LINE = 64 / sizeof(Slot);
+
+    /** Slots grouped by cache line, so that no slot straddles two lines. */
+    struct alignas(64) Line {
+        Slot slots[SLOTS_PER_LINE];
+    };
+
+    Slot& slotFor(ip_addr ip) {
+        // Fibonacci hashing: the top bits of the 64-bit product depend on every address
+        // bit, including the last octet, which is the high byte of a network order address
+        size_t index = ((ip * 0x9E3779B97F4A7C15ull) >> 40) & slotMask;
+        return lines[index / SLOTS_PER_LINE].slots[index % SLOTS_PER_LINE];
+    }
+
+    std::vector<Line> lines;
+    size_t slotMask;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+};
+
+#endif  // ROUTECACHE_H
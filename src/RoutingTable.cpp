@@ -3,85 +3,697 @@
 #include <arpa/inet.h>
 #include <spdlog/spdlog.h>
 
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+#include <utility>
 
-RoutingTable::RoutingTable(const std::filesystem::path& routingTablePath) {
+#include "MappedFile.h"
+#include "Rcu.h"
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Returns the next whitespace-separated token of the line and moves pos past it
+std::string_view nextToken(const char*& pos, const char* end) {
+    while (pos < end && isSpace(*pos)) {
+        ++pos;
+    }
+    const char* start = pos;
+    while (pos < end && !isSpace(*pos)) {
+        ++pos;
+    }
+    return {start, static_cast<size_t>(pos - start)};
+}
+
+// Accepts exactly what inet_pton(AF_INET) accepts: four decimal octets, no leading zeros
+bool parseIpv4(std::string_view text, ip_addr& out) {
+    uint32_t addr = 0;
+    int octets = 0;
+    size_t i = 0;
+    while (true) {
+        size_t start = i;
+        uint32_t octet = 0;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+            octet = octet * 10 + (text[i] - '0');
+            if (octet > 255) {
+                return false;
+            }
+            ++i;
+        }
+        if (i == start || (i - start > 1 && text[start] == '0')) {
+            return false;
+        }
+
+        addr = (addr << 8) | octet;
+        if (++octets == 4) {
+            break;
+        }
+        if (i >= text.size() || text[i] != '.') {
+            return false;
+        }
+        ++i;
+    }
+    if (i != text.size()) {
+        return false;
+    }
+
+    out = htonl(addr);
+    return true;
+}
+
+}  // namespace
+
+std::vector<RoutingEntry> parseRoutingTableFile(const std::filesystem::path& routingTablePath) {
     if (!std::filesystem::exists(routingTablePath)) {
         throw std::runtime_error("Routing table file does not exist");
     }
 
-    std::ifstream file(routingTablePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open routing table file");
+    MappedFile file(routingTablePath);
+    const char* pos = reinterpret_cast<const char*>(file.bytes().data());
+    const char* end = pos + file.size();
+
+    std::vector<RoutingEntry> entries;
+    entries.reserve(std::count(pos, end, '\n') + 1);
+
+    size_t lineNumber = 0;
+    while (pos < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        const char* lineStart = pos;
+        ++lineNumber;
+
+        std::string_view dest = nextToken(pos, lineEnd);
+        if (!dest.empty()) {
+            std::string_view gateway = nextToken(pos, lineEnd);
+            std::string_view mask = nextToken(pos, lineEnd);
+            std::string_view iface = nextToken(pos, lineEnd);
+
+            RoutingEntry& entry = entries.emplace_back();
+            if (!parseIpv4(dest, entry.dest) || !parseIpv4(gateway, entry.gateway) || !parseIpv4(mask, entry.mask)) {
+                spdlog::error("Invalid IP address format in routing table file on line {}: {}", lineNumber,
+                              std::string_view(lineStart, lineEnd - lineStart));
+                throw std::runtime_error("Invalid IP address format in routing table file");
+            }
+            // Interface names are short enough to stay in the string's inline buffer
+            entry.iface = iface;
+        }
+
+        pos = lineEnd + 1;
+    }
+
+    return entries;
+}
+
+RoutingTable::RoutingTable(const std::filesystem::path& routingTablePath, FibEngine engine,
+                           AggregationOptions aggregation)
+    : RoutingTable(parseRoutingTableFile(routingTablePath), engine, aggregation) {
+}
+
+RoutingTable::RoutingTable(const std::vector<RoutingEntry>& entries, FibEngine engine, AggregationOptions aggregation)
+    : engine(engine), aggregation(aggregation) {
+    std::lock_guard lock(updateMutex);
+    routes = makeRoutes(entries);
+
+    fib = compile(routes, true);
+    auto initial = std::make_unique<Snapshot>();
+    initial->fib = fib;
+    publish(std::move(initial));
+}
+
+RoutingTable::RoutingTable(const FibSnapshot& fibSnapshot) {
+    const FibSnapshotContents& contents = fibSnapshot.contents();
+    std::lock_guard lock(updateMutex);
+    engine = contents.fib->engine();
+    aggregation.enabled = contents.aggregated;
+
+    // Interning in snapshot order reproduces the indices stored in the FIB
+    for (size_t i = 0; i < contents.interfaceNames.size(); ++i) {
+        if (internInterface(std::string(contents.interfaceNames[i])) != i) {
+            throw std::runtime_error("FIB snapshot has duplicate interface names");
+        }
+    }
+    for (size_t i = 0; i < contents.nextHopGateways.size(); ++i) {
+        if (contents.nextHopInterfaces[i] >= interfaceNames.size() ||
+            internNextHop(contents.nextHopGateways[i], contents.nextHopInterfaces[i]) != i) {
+            throw std::runtime_error("FIB snapshot has invalid next hops");
+        }
+    }
+    std::unordered_set<uint32_t> groupStarts;
+    std::span<const uint32_t> groups = contents.nextHopGroups;
+    for (size_t offset = 0; offset < groups.size(); offset += groups[offset] + 1) {
+        if (groups[offset] < 2 || groups[offset] >= groups.size() - offset) {
+            throw std::runtime_error("FIB snapshot has invalid next hop groups");
+        }
+        std::vector<uint32_t> members(groups.begin() + offset + 1, groups.begin() + offset + 1 + groups[offset]);
+        bool valid = std::all_of(members.begin(), members.end(),
+                                 [&](uint32_t member) { return member < nextHops.size(); });
+        if (!valid || internGroup(members) != (ECMP_GROUP | offset)) {
+            throw std::runtime_error("FIB snapshot has invalid next hop groups");
+        }
+        groupStarts.insert(ECMP_GROUP | offset);
+    }
+
+    auto isValidValue = [&](uint32_t value) {
+        return (value & ECMP_GROUP) ? groupStarts.contains(value) : value < nextHops.size();
+    };
+
+    routes.reserve(contents.routeDests.size());
+    for (size_t i = 0; i < contents.routeDests.size(); ++i) {
+        uint32_t value = contents.routeNextHops[i];
+        if (!isValidValue(value)) {
+            throw std::runtime_error("FIB snapshot has routes with invalid next hops");
+        }
+        routes.emplace(prefixKey(contents.routeDests[i], contents.routeMasks[i]),
+                       Route{value, contents.routeDests[i], nextSequence++});
+    }
+
+    // Lookups resolve the values in the FIB without bounds checks
+    for (uint32_t value : contents.fib->storedValues()) {
+        if (value != Fib::NO_MATCH && !isValidValue(value)) {
+            throw std::runtime_error("FIB snapshot has FIB entries with invalid next hops");
+        }
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty()) {
-            continue;
+    fib = contents.fib;
+    auto initial = std::make_unique<Snapshot>();
+    initial->fib = fib;
+    publish(std::move(initial));
+
+    spdlog::info("Loaded {} routes with {} next hops from a {} FIB snapshot (hash {}).", routes.size(),
+                 nextHops.size(), fibEngineName(engine), fibSnapshot.hash());
+}
+
+RoutingTable::~RoutingTable() {
+    // No reader can be left once the table itself goes away; flush the retired snapshots too
+    delete snapshot.load();
+    rcu::synchronize();
+}
+
+RoutingTable::RouteMap RoutingTable::makeRoutes(const std::vector<RoutingEntry>& entries) {
+    RouteMap prefixes;
+    prefixes.reserve(entries.size());
+
+    for (const auto& entry : entries) {
+        uint32_t nextHop = internNextHop(entry.gateway, internInterface(entry.iface));
+        auto [it, inserted] =
+            prefixes.try_emplace(prefixKey(entry.dest, entry.mask), Route{nextHop, entry.dest, nextSequence});
+        if (inserted) {
+            nextSequence++;
+        }
+        else {
+            it->second.value = addPath(it->second.value, nextHop);
         }
+    }
+    return prefixes;
+}
 
-        std::istringstream iss(line);
-        std::string dest, gateway, mask, iface;
-        iss >> dest >> gateway >> mask >> iface;
+uint32_t RoutingTable::addPath(uint32_t value, uint32_t nextHop) {
+    std::vector<uint32_t> members;
+    if (value & ECMP_GROUP) {
+        uint32_t offset = value & ~ECMP_GROUP;
+        for (uint32_t i = 0; i < nextHopGroups[offset]; ++i) {
+            members.push_back(nextHopGroups[offset + 1 + i]);
+        }
+    }
+    else {
+        members.push_back(value);
+    }
+
+    if (std::find(members.begin(), members.end(), nextHop) != members.end()) {
+        return value;
+    }
+    members.push_back(nextHop);
+    return internGroup(members);
+}
+
+uint32_t RoutingTable::internGroup(const std::vector<uint32_t>& members) {
+    auto it = groupValues.find(members);
+    if (it != groupValues.end()) {
+        return it->second;
+    }
 
-        uint32_t dest_ip, gateway_ip, subnet_mask;
+    // The value must stay below NO_NEXT_HOP with the group bit set
+    static_assert(decltype(nextHopGroups)::CAPACITY >= (NO_NEXT_HOP & ~ECMP_GROUP), "groups fill the value range");
+    if (nextHopGroups.size() + members.size() + 1 >= (NO_NEXT_HOP & ~ECMP_GROUP)) {
+        throw std::runtime_error("Too many next hop groups in routing table");
+    }
+    uint32_t value = ECMP_GROUP | nextHopGroups.push_back(members.size());
+    for (uint32_t member : members) {
+        nextHopGroups.push_back(member);
+    }
+    groupValues.emplace(members, value);
+    return value;
+}
 
-        if (inet_pton(AF_INET, dest.c_str(), &dest_ip) != 1 ||
-            inet_pton(AF_INET, gateway.c_str(), &gateway_ip) != 1 ||
-            inet_pton(AF_INET, mask.c_str(), &subnet_mask) != 1) {
-            spdlog::error("Invalid IP address format in routing table file: {}", line);
-            throw std::runtime_error("Invalid IP address format in routing table file");
+void RoutingTable::addRoute(ip_addr dest, ip_addr gateway, ip_addr mask, const std::string& iface) {
+    std::lock_guard lock(updateMutex);
+
+    uint32_t nextHop = internNextHop(gateway, internInterface(iface));
+    auto [it, inserted] = routes.try_emplace(prefixKey(dest, mask), Route{nextHop, dest, nextSequence});
+    if (inserted) {
+        nextSequence++;
+    }
+    else {
+        uint32_t value = addPath(it->second.value, nextHop);
+        if (value == it->second.value) {
+            return;
         }
+        it->second.value = value;
+    }
 
-        routingEntries.push_back({dest_ip, gateway_ip, subnet_mask, iface});
+    // An aggregated FIB has no entry of its own for the prefix to update
+    if (aggregation.enabled || !fib->updateRoute(dest, mask, it->second.value)) {
+        recompile();
+    } else {
+        generation.fetch_add(1, std::memory_order_release);
     }
 }
 
-std::optional<RoutingEntry> RoutingTable::getRoutingEntry(ip_addr ip) {
-    std::optional<RoutingEntry> bestMatch;
-    int longestMatch = -1;  // Tracks the length of the longest match in bits
-
-    for (const auto& entry : routingEntries) {
-        // Apply the subnet mask to both `ip` and `entry.dest`
-        ip_addr maskedIp = ip & entry.mask;
-        ip_addr maskedDest = entry.dest & entry.mask;
-
-        if (maskedIp == maskedDest) {
-            // Count the number of significant bits in the mask
-            int maskLength = __builtin_popcount(entry.mask);
-
-            // Update the best match if this is the longest match so far
-            if (maskLength > longestMatch) {
-                longestMatch = maskLength;
-                bestMatch = entry;
+bool RoutingTable::removeRoute(ip_addr dest, ip_addr mask) {
+    std::lock_guard lock(updateMutex);
+
+    auto it = routes.find(prefixKey(dest, mask));
+    if (it == routes.end()) {
+        return false;
+    }
+    routes.erase(it);
+
+    // The addresses of the prefix fall back to the longest shorter prefix containing it
+    std::optional<FibRoute> covering;
+    if (isContiguousMask(mask)) {
+        uint32_t hostMask = ntohl(mask);
+        while (hostMask != 0 && !covering) {
+            hostMask <<= 1;
+            ip_addr shorter = htonl(hostMask);
+            auto found = routes.find(prefixKey(dest, shorter));
+            if (found != routes.end()) {
+                covering = FibRoute{dest & shorter, shorter, found->second.value};
             }
         }
     }
 
+    if (aggregation.enabled || !fib->removeRoute(dest, mask, covering ? &*covering : nullptr)) {
+        recompile();
+    } else {
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    return true;
+}
+
+void RoutingTable::recompile() {
+    // Single route changes are not verified again; they would each cost a full pass
+    install(compile(routes, false));
+}
+
+void RoutingTable::install(std::shared_ptr<Fib> compiled) {
+    fib = std::move(compiled);
+    auto next = std::make_unique<Snapshot>(*snapshot.load());
+    next->fib = fib;
+    publish(std::move(next));
+}
+
+bool RoutingTable::reload(const std::filesystem::path& routingTablePath) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Parse outside the lock; a broken file leaves the current table in place
+    std::vector<RoutingEntry> entries;
+    try {
+        entries = parseRoutingTableFile(routingTablePath);
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to reload routing table from {}: {}", routingTablePath.string(), e.what());
+        return false;
+    }
+
+    std::lock_guard lock(updateMutex);
+
+    // Nothing is replaced until the new table has compiled
+    RouteMap next;
+    std::shared_ptr<Fib> compiled;
+    try {
+        next = makeRoutes(entries);
+        compiled = compile(next, true);
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to reload routing table from {}: {}", routingTablePath.string(), e.what());
+        return false;
+    }
+
+    // Keep the old prefixes to report what changed
+    RouteMap previous = std::exchange(routes, std::move(next));
+
+    install(std::move(compiled));
+
+    size_t added = 0, changed = 0, kept = 0;
+    for (const auto& [key, route] : routes) {
+        auto it = previous.find(key);
+        if (it == previous.end()) {
+            added++;
+        }
+        else if (it->second.value != route.value) {
+            changed++;
+        }
+        else {
+            kept++;
+        }
+    }
+    size_t removed = previous.size() - changed - kept;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    spdlog::info("Reloaded routing table from {} in {} ms: {} prefixes, {} added, {} removed, {} changed next hop.",
+                 routingTablePath.string(), elapsed.count(), routes.size(), added, removed, changed);
+    return true;
+}
+
+void RoutingTable::writeSnapshot(const std::filesystem::path& path) {
+    std::lock_guard lock(updateMutex);
+
+    std::vector<ip_addr> gateways;
+    std::vector<uint32_t> interfaces;
+    for (size_t i = 0; i < nextHops.size(); ++i) {
+        gateways.push_back(nextHops[i].gateway);
+        interfaces.push_back(nextHops[i].iface);
+    }
+
+    std::vector<ip_addr> dests, masks;
+    std::vector<uint32_t> routeNextHops;
+    for (const auto& [key, route] : inAdditionOrder(routes)) {
+        dests.push_back(route.dest);
+        masks.push_back(static_cast<uint32_t>(key));
+        routeNextHops.push_back(route.value);
+    }
+
+    std::vector<uint32_t> groups;
+    for (size_t i = 0; i < nextHopGroups.size(); ++i) {
+        groups.push_back(nextHopGroups[i]);
+    }
+
+    FibSnapshotContents contents{dests, masks, routeNextHops, gateways, interfaces, groups, {}, fib,
+                                 aggregation.enabled};
+    for (size_t i = 0; i < interfaceNames.size(); ++i) {
+        contents.interfaceNames.push_back(interfaceNames[i]);
+    }
+
+    FibSnapshot::write(path, contents);
+}
+
+InterfaceId RoutingTable::internInterface(const std::string& name) {
+    auto it = interfaceIds.find(name);
+    if (it != interfaceIds.end()) {
+        return it->second;
+    }
+
+    if (interfaceNames.size() > std::numeric_limits<InterfaceId>::max()) {
+        throw std::runtime_error("Too many interfaces in routing table");
+    }
+    InterfaceId id = interfaceNames.push_back(name);
+    interfaceIds.emplace(name, id);
+    return id;
+}
+
+uint32_t RoutingTable::internNextHop(ip_addr gateway, InterfaceId iface) {
+    uint64_t key = (static_cast<uint64_t>(gateway) << 16) | iface;
+    auto it = nextHopIndices.find(key);
+    if (it != nextHopIndices.end()) {
+        return it->second;
+    }
+
+    static_assert(decltype(nextHops)::CAPACITY >= ECMP_GROUP && decltype(nextHopCounters)::CAPACITY >= ECMP_GROUP,
+                  "next hops fill the value range");
+    if (nextHops.size() >= ECMP_GROUP) {
+        throw std::runtime_error("Too many next hops in routing table");
+    }
+    uint32_t index = nextHops.push_back({gateway, iface});
+    nextHopCounters.emplace_back();
+    nextHopIndices.emplace(key, index);
+    return index;
+}
+
+std::shared_ptr<Fib> RoutingTable::compile(const RouteMap& prefixes, bool verify) const {
+    static_assert(NO_NEXT_HOP == Fib::NO_MATCH, "next hop indices are stored in the FIB as is");
+
+    std::vector<FibRoute> fibRoutes;
+    fibRoutes.reserve(prefixes.size());
+    for (const auto& [key, route] : inAdditionOrder(prefixes)) {
+        fibRoutes.push_back({static_cast<ip_addr>(key >> 32), static_cast<ip_addr>(key), route.value});
+    }
+
+    if (!aggregation.enabled) {
+        std::shared_ptr<Fib> compiled = buildFib(engine, fibRoutes);
+        spdlog::info("Compiled {} routes with {} next hops into a {} FIB ({} KiB).", prefixes.size(),
+                     nextHops.size(), fibEngineName(compiled->engine()), compiled->memoryUsage() / 1024);
+        return compiled;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<FibRoute> aggregatedRoutes = aggregateRoutes(fibRoutes);
+    std::shared_ptr<Fib> aggregated = buildFib(engine, aggregatedRoutes);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    // Sized from the routes: the unaggregated FIB is only built to verify against
+    spdlog::info("Aggregated {} prefixes with {} next hops into {} in {} ms: a {} FIB, {} KiB before, {} KiB after.",
+                 fibRoutes.size(), nextHops.size(), aggregatedRoutes.size(), elapsed.count(),
+                 fibEngineName(aggregated->engine()), fibMemoryFor(engine, fibRoutes) / 1024,
+                 aggregated->memoryUsage() / 1024);
+
+    // The unaggregated FIB is only needed as the reference to verify against
+    if (verify && aggregation.verify != FibVerifyMode::None) {
+        std::shared_ptr<Fib> compiled = buildFib(engine, fibRoutes);
+        start = std::chrono::steady_clock::now();
+        uint64_t mismatches = compareFibs(*compiled, *aggregated, aggregation.verify, fibRoutes);
+        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        if (mismatches != 0) {
+            spdlog::error("Aggregated FIB differs from the routes for {} addresses. Using the unaggregated FIB.",
+                          mismatches);
+            return compiled;
+        }
+        spdlog::info("Verified the aggregated FIB against the routes in {} ms.", elapsed.count());
+    }
+    return aggregated;
+}
+
+std::vector<std::pair<uint64_t, RoutingTable::Route>> RoutingTable::inAdditionOrder(const RouteMap& prefixes) {
+    std::vector<std::pair<uint64_t, Route>> ordered(prefixes.begin(), prefixes.end());
+    std::sort(ordered.begin(), ordered.end(),
+              [](const auto& a, const auto& b) { return a.second.sequence < b.second.sequence; });
+    return ordered;
+}
+
+void RoutingTable::publish(std::unique_ptr<Snapshot> next) {
+    const Snapshot* previous = snapshot.exchange(next.release());
+    generation.fetch_add(1, std::memory_order_release);
+    if (previous) {
+        rcu::retire(previous);
+    }
+}
+
+std::optional<RoutingEntry> RoutingTable::getRoutingEntry(ip_addr ip) {
+    FibMatch match;
+    {
+        rcu::ReadGuard guard;
+        match = snapshot.load()->fib->match(ip);
+    }
+
     // Log a warning if no match is found
-    if (!bestMatch) {
+    if (match.value == NO_NEXT_HOP) {
         spdlog::warn("No routing entry found for IP: {}.", ip);
+        return std::nullopt;
+    }
+
+    const NextHop& nextHop = nextHops[resolve(match.value, 0)];
+    ip_addr dest = ip & match.mask;
+    {
+        // An aggregate has no route of its own; it is reported as its prefix
+        std::lock_guard lock(updateMutex);
+        auto it = routes.find(prefixKey(dest, match.mask));
+        if (it != routes.end()) {
+            dest = it->second.dest;
+        }
     }
+    return RoutingEntry{dest, nextHop.gateway, match.mask, interfaceNames[nextHop.iface]};
+}
 
-    return bestMatch;
+uint32_t RoutingTable::lookupNextHop(ip_addr ip, uint32_t flowHash) {
+    rcu::ReadGuard guard;
+    return resolve(snapshot.load()->fib->lookup(ip), flowHash);
+}
+
+uint32_t RoutingTable::lookupNextHop(ip_addr ip, uint32_t flowHash, RouteCache& cache) {
+    // Read before the lookup: a change racing with it leaves the entry stale, never current
+    uint64_t current = getGeneration();
+    std::optional<uint32_t> cached = cache.find(ip, current);
+    if (cached) {
+        return resolve(*cached, flowHash);
+    }
+
+    uint32_t value;
+    {
+        rcu::ReadGuard guard;
+        value = snapshot.load()->fib->lookup(ip);
+    }
+    // The FIB value rather than the next hop, so equal-cost routes still spread by flow
+    cache.insert(ip, current, value);
+    return resolve(value, flowHash);
+}
+
+void RoutingTable::lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out,
+                               std::span<const uint32_t> flowHashes) {
+    {
+        rcu::ReadGuard guard;
+        snapshot.load()->fib->lookupBatch(ips, out);
+    }
+    // Groups are never removed, so they can be read outside the guard
+    for (size_t i = 0; i < ips.size(); ++i) {
+        out[i] = resolve(out[i], flowHashes.empty() ? 0 : flowHashes[i]);
+    }
+}
+
+void RoutingTable::lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out,
+                               std::span<const uint32_t> flowHashes, RouteCache& cache) {
+    constexpr size_t GROUP = 64;
+
+    // Read before the lookups, as in lookupNextHop()
+    uint64_t current = getGeneration();
+    for (size_t base = 0; base < ips.size(); base += GROUP) {
+        size_t count = std::min(GROUP, ips.size() - base);
+
+        // Answer what the cache can and collect the misses
+        std::array<ip_addr, GROUP> missIps;
+        std::array<uint32_t, GROUP> missValues;
+        std::array<size_t, GROUP> missAt;
+        size_t misses = 0;
+        for (size_t i = base; i < base + count; ++i) {
+            std::optional<uint32_t> cached = cache.find(ips[i], current);
+            if (cached) {
+                out[i] = *cached;
+            } else {
+                missIps[misses] = ips[i];
+                missAt[misses++] = i;
+            }
+        }
+
+        if (misses > 0) {
+            {
+                rcu::ReadGuard guard;
+                snapshot.load()->fib->lookupBatch(std::span(missIps.data(), misses),
+                                                  std::span(missValues.data(), misses));
+            }
+            for (size_t j = 0; j < misses; ++j) {
+                cache.insert(missIps[j], current, missValues[j]);
+                out[missAt[j]] = missValues[j];
+            }
+        }
+
+        for (size_t i = base; i < base + count; ++i) {
+            out[i] = resolve(out[i], flowHashes.empty() ? 0 : flowHashes[i]);
+        }
+    }
+}
+
+void RoutingTable::countRouted(uint32_t index, size_t bytes) {
+    NextHopCounters& counters = nextHopCounters[index];
+    counters.packets.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void RoutingTable::logNextHopCounters() {
+    size_t count = nextHopCounters.size();
+    uint64_t totalPackets = 0;
+    for (size_t i = 0; i < count; ++i) {
+        totalPackets += nextHopCounters[i].packets.load(std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t packets = nextHopCounters[i].packets.load(std::memory_order_relaxed);
+        uint64_t bytes = nextHopCounters[i].bytes.load(std::memory_order_relaxed);
+        char gateway[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &nextHops[i].gateway, gateway, sizeof(gateway));
+        spdlog::info("Next hop {} via {}: {} packets ({:.1f}%), {} bytes routed.", gateway,
+                     interfaceNames[nextHops[i].iface], packets,
+                     totalPackets ? 100.0 * packets / totalPackets : 0.0, bytes);
+    }
+}
+
+NextHop RoutingTable::getNextHop(uint32_t index) {
+    return nextHops[index];
+}
+
+const std::string& RoutingTable::getInterfaceName(InterfaceId id) {
+    return interfaceNames[id];
 }
 
 RoutingInterface RoutingTable::getRoutingInterface(const std::string& iface) {
-    auto it = routingInterfaces.find(iface);
-    if (it == routingInterfaces.end()) {
-        spdlog::error("Interface '{}' not found in routing table.", iface);
-        throw std::invalid_argument("Interface not found");
+    {
+        rcu::ReadGuard guard;
+        const auto& interfaces = snapshot.load()->interfaces;
+        auto it = interfaces.find(iface);
+        if (it != interfaces.end()) {
+            return it->second;
+        }
     }
-    return it->second;
-    // return routingInterfaces.at(iface);
+
+    spdlog::error("Interface '{}' not found in routing table.", iface);
+    throw std::invalid_argument("Interface not found");
 }
 
 void RoutingTable::setRoutingInterface(const std::string& iface, const mac_addr& mac, const ip_addr& ip) {
-    routingInterfaces[iface] = {iface, mac, ip};
+    setRoutingInterfaces({{iface, mac, ip}});
+}
+
+void RoutingTable::setRoutingInterfaces(const std::vector<RoutingInterface>& interfaces) {
+    std::lock_guard lock(updateMutex);
+
+    auto next = std::make_unique<Snapshot>(*snapshot.load());
+    for (const auto& iface : interfaces) {
+        next->interfaces[iface.name] = iface;
+    }
+    publish(std::move(next));
+}
+
+std::vector<ip_addr> RoutingTable::getGateways() {
+    std::lock_guard lock(updateMutex);
+
+    std::unordered_set<ip_addr> seen;
+    std::vector<ip_addr> gateways;
+    auto add = [&](uint32_t nextHop) {
+        ip_addr gateway = nextHops[nextHop].gateway;
+        if (gateway != 0 && seen.insert(gateway).second) {
+            gateways.push_back(gateway);
+        }
+    };
+
+    for (const auto& [key, route] : routes) {
+        uint32_t value = route.value;
+        if (value & ECMP_GROUP) {
+            uint32_t offset = value & ~ECMP_GROUP;
+            for (uint32_t i = 0; i < nextHopGroups[offset]; ++i) {
+                add(nextHopGroups[offset + 1 + i]);
+            }
+        }
+        else {
+            add(value);
+        }
+    }
+    return gateways;
+}
+
+std::unordered_map<std::string, RoutingInterface> RoutingTable::getRoutingInterfaces() const {
+    rcu::ReadGuard guard;
+    return snapshot.load()->interfaces;
 }
 
-const std::unordered_map<std::string, RoutingInterface>& RoutingTable::getRoutingInterfaces() const {
-    return routingInterfaces;
+bool RoutingTable::isInterfaceAddress(ip_addr ip) const {
+    rcu::ReadGuard guard;
+    for (const auto& [name, interface] : snapshot.load()->interfaces) {
+        if (interface.ip == ip) {
+            return true;
+        }
+    }
+    return false;
 }
@@ -2,31 +2,302 @@
 #define ROUTINGTABLE_H
 #include "RouterTypes.h"
 
+#include <atomic>
 #include <string>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 
+#include "AppendOnlyArray.h"
+#include "Fib.h"
+#include "FibAggregation.h"
+#include "FibSnapshot.h"
 #include "IRoutingTable.h"
 
+/**
+ * @brief Reads a routing table file: one "dest gateway mask iface" entry per line.
+ *
+ * The file is mapped and scanned in place, without per-line stream or string
+ * temporaries. What allocates is the result: the entry vector, and each interface
+ * name too long for the small string buffer.
+ * @throws std::runtime_error if the file is missing or malformed.
+ */
+std::vector<RoutingEntry> parseRoutingTableFile(const std::filesystem::path& routingTablePath);
+
+/**
+ * @class RoutingTable
+ * @brief Routing table whose readers never take a lock.
+ *
+ * Everything a lookup depends on (the compiled FIB and the interfaces) lives in an
+ * immutable Snapshot that readers reach with a single atomic pointer load inside an
+ * RCU read guard. Updates copy what they change into a new Snapshot, publish it with
+ * one pointer store and retire the old one, so readers see either the old or the new
+ * table, never a mix. Next hops and interface names are only ever appended, which
+ * keeps the indices returned by lookups meaningful across snapshots.
+ *
+ * Single routes are added and removed by updating the current FIB in place where the
+ * engine supports it (DIR-24-8), and by compiling and publishing a new one otherwise.
+ *
+ * A prefix listed several times with different next hops is an equal-cost multipath
+ * route. The FIB then maps it to a next hop group, whose members are stored one after
+ * the other in an append-only array after their count; lookups pick a member with the
+ * flow hash.
+ *
+ * With aggregation enabled the FIB is compiled from the smallest set of prefixes that
+ * forwards the same way as the routes, and no longer holds the routes one to one; every
+ * change is then applied by aggregating and compiling the whole table again. The result
+ * is verified at construction and on reload only.
+ */
 class RoutingTable : public IRoutingTable {
 public:
     /**
      * @brief Constructs a RoutingTable object from a given file path.
      * @param routingTablePath The path to the file containing routing table entries.
+     * @param engine The lookup structure compiled from the entries.
+     * @param aggregation Whether the entries are aggregated before they are compiled.
+     */
+    explicit RoutingTable(const std::filesystem::path& routingTablePath, FibEngine engine = FibEngine::Dir24_8,
+                          AggregationOptions aggregation = {});
+
+    /**
+     * @brief Constructs a RoutingTable object from already parsed entries.
+     * @param entries The routing entries, in routing table file order.
+     * @param engine The lookup structure compiled from the entries.
+     * @param aggregation Whether the entries are aggregated before they are compiled.
+     */
+    RoutingTable(const std::vector<RoutingEntry>& entries, FibEngine engine, AggregationOptions aggregation = {});
+
+    /**
+     * @brief Constructs a RoutingTable object from a precompiled FIB snapshot.
+     *
+     * The FIB is used as stored, with the engine it was compiled for; later reloads
+     * compile with that engine too, and aggregate if the stored FIB was aggregated.
+     * @throws std::runtime_error if the snapshot is inconsistent.
+     */
+    explicit RoutingTable(const FibSnapshot& fibSnapshot);
+
+    ~RoutingTable() override;
+
+    /**
+     * @brief Replaces all routing entries with the contents of a routing table file.
+     *
+     * The new FIB is compiled on the calling thread and swapped in atomically;
+     * interfaces are kept. Lookups running concurrently see either the old or the new
+     * table. If the file cannot be parsed or compiled the current table stays in place.
+     *
+     * Next hops, next hop groups and interface names are never freed, since lookups may
+     * still hold their indices: every distinct one a reload introduces stays for the life
+     * of the process. Reloads fail once there would be more than 2^23 next hops, 2^23
+     * group words or 2^16 interfaces.
+     * @return Whether the new table was installed.
      */
-    explicit RoutingTable(const std::filesystem::path& routingTablePath);
+    bool reload(const std::filesystem::path& routingTablePath);
 
+    /**
+     * @brief Saves the routing entries and the compiled FIB as a snapshot file.
+     * @throws std::runtime_error on I/O errors.
+     */
+    void writeSnapshot(const std::filesystem::path& path);
+
+    /**
+     * @brief Adds a route. If the prefix already has routes, the next hop joins them as
+     * an equal-cost path.
+     *
+     * With the DIR-24-8 engine the cost depends on the prefix length only; lookups
+     * running concurrently see each address switch atomically. The linear engine, a
+     * DIR-24-8 FIB out of tbl8 groups, or an aggregated FIB is recompiled, which costs
+     * time linear in the size of the table.
+     */
+    void addRoute(ip_addr dest, ip_addr gateway, ip_addr mask, const std::string& iface);
+
+    /**
+     * @brief Withdraws every route for a prefix; its addresses fall back to the next
+     * shorter matching prefix. Costs the same as addRoute().
+     * @return Whether a route for the prefix existed.
+     */
+    bool removeRoute(ip_addr dest, ip_addr mask);
+
+    /**
+     * @brief Returns the first route of the longest matching prefix, with its destination
+     * as written in the routing table. With aggregation the prefix reported is the
+     * aggregate the address falls in. Takes the update lock.
+     */
     std::optional<RoutingEntry> getRoutingEntry(ip_addr ip) override;
 
+    uint32_t lookupNextHop(ip_addr ip, uint32_t flowHash = 0) override;
+
+    uint32_t lookupNextHop(ip_addr ip, uint32_t flowHash, RouteCache& cache) override;
+
+    /**
+     * @brief Returns a counter that increases whenever routes or interfaces change.
+     */
+    uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
+
+    void lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out,
+                     std::span<const uint32_t> flowHashes = {}) override;
+
+    void lookupBatch(std::span<const ip_addr> ips, std::span<uint32_t> out, std::span<const uint32_t> flowHashes,
+                     RouteCache& cache) override;
+
+    void countRouted(uint32_t index, size_t bytes) override;
+
+    /**
+     * @brief Logs the packets and bytes routed to every next hop so far.
+     */
+    void logNextHopCounters();
+
+    NextHop getNextHop(uint32_t index) override;
+
+    const std::string& getInterfaceName(InterfaceId id) override;
+
     RoutingInterface getRoutingInterface(const std::string& iface) override;
 
     void setRoutingInterface(const std::string& iface, const mac_addr& mac, const ip_addr& ip) override;
 
-    const std::unordered_map<std::string, RoutingInterface>& getRoutingInterfaces() const override;
+    /**
+     * @brief Sets several interfaces at once; readers see all of them change together.
+     */
+    void setRoutingInterfaces(const std::vector<RoutingInterface>& interfaces);
+
+    std::unordered_map<std::string, RoutingInterface> getRoutingInterfaces() const override;
+
+    bool isInterfaceAddress(ip_addr ip) const override;
+
+    /**
+     * @brief Returns every distinct gateway the current routes forward to, each once,
+     * including every member of equal-cost groups. Takes the update lock.
+     */
+    std::vector<ip_addr> getGateways();
 
 private:
-    std::vector<RoutingEntry> routingEntries; /**< Collection of routing entries. */
-    std::unordered_map<std::string, RoutingInterface> routingInterfaces; /**< Map of interface names to routing interfaces. */
+    /**
+     * @struct Snapshot
+     * @brief Immutable state shared with readers. Replaced as a whole, never modified.
+     */
+    struct Snapshot {
+        std::shared_ptr<const Fib> fib; /**< Maps addresses to next hops or groups. Shared between snapshots. */
+        std::unordered_map<std::string, RoutingInterface> interfaces; /**< Map of interface names to routing interfaces. */
+    };
+
+    /**
+     * @struct Route
+     * @brief The routes of one prefix.
+     */
+    struct Route {
+        uint32_t value;    /**< Next hop index or next hop group, as stored in the FIB. */
+        ip_addr dest;      /**< Destination of the first route, host bits included. */
+        uint64_t sequence; /**< Orders the prefixes by when their first route was added. */
+    };
+
+    using RouteMap = std::unordered_map<uint64_t, Route>; /**< prefixKey(dest, mask) to the routes of that prefix. */
+
+    /**
+     * @brief Groups the entries by prefix, interning their next hops. Requires updateMutex.
+     * @throws std::runtime_error if the next hop or interface limits are exceeded.
+     */
+    RouteMap makeRoutes(const std::vector<RoutingEntry>& entries);
+
+    /**
+     * @brief Compiles the given routes into a new FIB. Requires updateMutex.
+     * @param verify Whether to check an aggregated FIB as the aggregation options ask.
+     * @throws std::invalid_argument if the routes cannot be compiled.
+     */
+    std::shared_ptr<Fib> compile(const RouteMap& prefixes, bool verify) const;
+
+    /**
+     * @brief Returns the prefixes in the order their first route was added, which is the
+     * routing table file order. The FIB builders rely on it to let the first of several
+     * routes they cannot tell apart win.
+     */
+    static std::vector<std::pair<uint64_t, Route>> inAdditionOrder(const RouteMap& prefixes);
+
+    /**
+     * @brief Compiles the routes into a new FIB and publishes it. Requires updateMutex.
+     */
+    void recompile();
+
+    /**
+     * @brief Publishes a snapshot with the given FIB. Requires updateMutex.
+     */
+    void install(std::shared_ptr<Fib> compiled);
+
+    static uint64_t prefixKey(ip_addr dest, ip_addr mask) {
+        return (static_cast<uint64_t>(dest & mask) << 32) | mask;
+    }
+
+    /** Marks FIB values that are offsets into nextHopGroups rather than next hop indices. */
+    static constexpr uint32_t ECMP_GROUP = 1u << 23;
+
+    /**
+     * @brief Turns a FIB value into a next hop index, picking a group member by flow hash.
+     */
+    uint32_t resolve(uint32_t value, uint32_t flowHash) const {
+        if (value == NO_NEXT_HOP || !(value & ECMP_GROUP)) {
+            return value;
+        }
+        uint32_t offset = value & ~ECMP_GROUP;
+        uint32_t count = nextHopGroups[offset];
+        // Maps the hash onto [0, count) without a division
+        return nextHopGroups[offset + 1 + ((static_cast<uint64_t>(flowHash) * count) >> 32)];
+    }
+
+    /**
+     * @brief Returns the FIB value for the next hops of value plus nextHop.
+     */
+    uint32_t addPath(uint32_t value, uint32_t nextHop);
+
+    uint32_t internGroup(const std::vector<uint32_t>& members);
+
+    /**
+     * @brief Makes the given snapshot current, retires the previous one and bumps the
+     * generation. Requires updateMutex.
+     */
+    void publish(std::unique_ptr<Snapshot> next);
+
+    InterfaceId internInterface(const std::string& name);
+
+    uint32_t internNextHop(ip_addr gateway, InterfaceId iface);
+
+    std::atomic<const Snapshot*> snapshot{nullptr}; /**< Current snapshot, read under an RCU guard. */
+
+    /**
+     * Bumped after every change has become visible to lookups, so that a route cached
+     * under the previous generation is never served once the change is complete.
+     */
+    std::atomic<uint64_t> generation{1};
+
+    // Everything below is only used by writers, serialized by updateMutex
+    std::mutex updateMutex;
+
+    FibEngine engine; /**< Engine requested at construction, used for every recompile. */
+    AggregationOptions aggregation; /**< Likewise. */
+
+    std::shared_ptr<Fib> fib; /**< The FIB of the current snapshot, for in-place updates. */
+
+    RouteMap routes; /**< The routes the current FIB was built from. */
+    uint64_t nextSequence = 0; /**< Route::sequence of the next prefix added. */
+
+    std::unordered_map<uint64_t, uint32_t> nextHopIndices; /**< (gateway, interface) to index into nextHops. */
+    std::map<std::vector<uint32_t>, uint32_t> groupValues; /**< Members to FIB value of the group. */
+    std::unordered_map<std::string, InterfaceId> interfaceIds; /**< Interface names to InterfaceId. */
+
+    // Shared with readers; only ever appended to
+    AppendOnlyArray<NextHop, 10, 8192> nextHops; /**< Every distinct (gateway, interface) pair, up to ECMP_GROUP. */
+    AppendOnlyArray<uint32_t, 10, 8192> nextHopGroups; /**< For each group, its member count followed by the members. */
+    AppendOnlyArray<std::string, 6, 1024> interfaceNames; /**< Interface names by InterfaceId. */
+
+    /**
+     * @struct NextHopCounters
+     * @brief Traffic routed to one next hop. Each on its own cache line, as next hops
+     * are typically used by several forwarding threads at once.
+     */
+    struct alignas(64) NextHopCounters {
+        std::atomic<uint64_t> packets{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+    AppendOnlyArray<NextHopCounters, 10, 8192> nextHopCounters; /**< Parallel to nextHops. */
 };
 
 
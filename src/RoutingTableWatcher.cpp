@@ -0,0 +1,158 @@
+#include "RoutingTableWatcher.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Editors and deploy scripts often touch the file several times in a row
+constexpr int DEBOUNCE_MS = 100;
+
+// Write end of the pipe of the active watcher, for the signal handler
+std::atomic<int> signalFd{-1};
+
+}  // namespace
+
+RoutingTableWatcher::RoutingTableWatcher(std::filesystem::path routingTablePath,
+                                         std::shared_ptr<RoutingTable> routingTable,
+                                         std::function<void()> onReload, std::function<void()> onStats)
+    : routingTablePath(std::move(routingTablePath)), routingTable(std::move(routingTable)),
+      onReload(std::move(onReload)), onStats(std::move(onStats)) {
+    if (pipe2(wakeupPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        throw std::runtime_error("Failed to create routing table watcher pipe");
+    }
+
+    if (this->routingTablePath.empty()) {
+        spdlog::info("Routing table reloads are disabled.");
+    }
+    else {
+        std::filesystem::path directory = this->routingTablePath.parent_path();
+        if (directory.empty()) {
+            directory = ".";
+        }
+
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            // SIGHUP still works without inotify
+            spdlog::warn("Cannot watch {} for changes ({}). Send SIGHUP to reload the routing table.",
+                         directory.string(), std::strerror(errno));
+        }
+    }
+
+    signalFd = wakeupPipe[1];
+    struct sigaction action{};
+    action.sa_handler = &RoutingTableWatcher::onSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGHUP, &action, &previousSighup);
+    sigaction(SIGUSR1, &action, &previousSigusr1);
+
+    thread = std::make_unique<std::thread>(&RoutingTableWatcher::loop, this);
+}
+
+RoutingTableWatcher::~RoutingTableWatcher() {
+    sigaction(SIGHUP, &previousSighup, nullptr);
+    sigaction(SIGUSR1, &previousSigusr1, nullptr);
+    signalFd = -1;
+
+    shutdown = true;
+    char wake = 0;
+    [[maybe_unused]] auto written = write(wakeupPipe[1], &wake, 1);
+    if (thread && thread->joinable()) {
+        thread->join();
+    }
+
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+    close(wakeupPipe[0]);
+    close(wakeupPipe[1]);
+}
+
+void RoutingTableWatcher::onSignal(int signal) {
+    int fd = signalFd.load();
+    if (fd >= 0) {
+        int savedErrno = errno;
+        char wake = static_cast<char>(signal);
+        [[maybe_unused]] auto written = write(fd, &wake, 1);
+        errno = savedErrno;
+    }
+}
+
+bool RoutingTableWatcher::drainInotify() {
+    bool relevant = false;
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + length;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(p);
+            if (event->len > 0 && routingTablePath.filename() == event->name) {
+                relevant = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return relevant;
+}
+
+void RoutingTableWatcher::loop() {
+    pollfd fds[2] = {{wakeupPipe[0], POLLIN, 0}, {inotifyFd, POLLIN, 0}};
+    nfds_t count = inotifyFd >= 0 ? 2 : 1;
+
+    bool pending = false;
+    while (!shutdown) {
+        // Once something changed, wait for the events to settle before reloading
+        int ready = poll(fds, count, pending ? DEBOUNCE_MS : -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            spdlog::error("Routing table watcher stopped: {}", std::strerror(errno));
+            return;
+        }
+
+        if (ready == 0) {
+            pending = false;
+            if (routingTable->reload(routingTablePath) && onReload) {
+                onReload();
+            }
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char signals[64];
+            ssize_t length;
+            while ((length = read(wakeupPipe[0], signals, sizeof(signals))) > 0) {
+                if (shutdown) {
+                    return;
+                }
+                for (ssize_t i = 0; i < length; ++i) {
+                    if (signals[i] == SIGHUP && routingTablePath.empty()) {
+                        spdlog::warn("Received SIGHUP, but routing table reloads are disabled.");
+                    }
+                    else if (signals[i] == SIGHUP) {
+                        spdlog::info("Received SIGHUP, reloading routing table.");
+                        pending = true;
+                    }
+                    else if (signals[i] == SIGUSR1) {
+                        routingTable->logNextHopCounters();
+                        if (onStats) {
+                            onStats();
+                        }
+                    }
+                }
+            }
+        }
+
+        if (count > 1 && (fds[1].revents & POLLIN) && drainInotify()) {
+            pending = true;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef ROUTINGTABLEWATCHER_H
+#define ROUTINGTABLEWATCHER_H
+
+#include <signal.h>
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "RoutingTable.h"
+
+/**
+ * @class RoutingTableWatcher
+ * @brief Reloads a routing table when its file changes or the process receives SIGHUP.
+ *
+ * A background thread watches the directory containing the file with inotify, so that
+ * both in-place writes and the usual write-to-temp-then-rename pattern are picked up.
+ * Bursts of events are coalesced before reloading. Parsing and compiling happen on the
+ * watcher thread; the router keeps forwarding on the old table until the new one is
+ * swapped in by RoutingTable::reload().
+ *
+ * SIGUSR1 logs the packets and bytes the table routed to each next hop, then runs an
+ * optional callback on the watcher thread for the statistics of other components.
+ *
+ * An optional callback runs on the watcher thread after every successful reload.
+ *
+ * With an empty path nothing is watched and SIGHUP is ignored, for tables that were not
+ * loaded from a routing table file.
+ *
+ * Only one watcher may exist at a time since it owns the SIGHUP and SIGUSR1
+ * dispositions.
+ */
+class RoutingTableWatcher {
+   public:
+    RoutingTableWatcher(std::filesystem::path routingTablePath, std::shared_ptr<RoutingTable> routingTable,
+                        std::function<void()> onReload = {}, std::function<void()> onStats = {});
+    ~RoutingTableWatcher();
+
+    RoutingTableWatcher(const RoutingTableWatcher&) = delete;
+    RoutingTableWatcher& operator=(const RoutingTableWatcher&) = delete;
+
+   private:
+    void loop();
+
+    /** Consumes pending inotify events and reports whether one concerned the table file. */
+    bool drainInotify();
+
+    static void onSignal(int signal);
+
+    std::filesystem::path routingTablePath;
+    std::shared_ptr<RoutingTable> routingTable;
+    std::function<void()> onReload;
+    std::function<void()> onStats;
+
+    int inotifyFd = -1;
+    int wakeupPipe[2] = {-1, -1}; /**< Signal numbers from the handler, 0 from the destructor. */
+
+    struct sigaction previousSighup{};
+    struct sigaction previousSigusr1{};
+
+    std::unique_ptr<std::thread> thread;
+    std::atomic<bool> shutdown = false;
+};
+
+#endif  // ROUTINGTABLEWATCHER_H
@@ -2,10 +2,12 @@
 
 #include <spdlog/spdlog.h>
 
+#include <array>
 #include <cstring>
 #include <iostream>
 
 #include "ArpCache.h"
+#include "Checksum.h"
 #include "IArpCache.h"
 #include "IPacketSender.h"
 #include "RoutingTable.h"
@@ -35,30 +37,158 @@ StaticRouter::StaticRouter(std::unique_ptr<IArpCache> arpCache, std::shared_ptr<
 void StaticRouter::handlePacket(std::vector<uint8_t> packet, std::string iface) {
     std::unique_lock lock(mutex);
 
-    if (packet.size() < sizeof(sr_ethernet_hdr_t)) {
-        spdlog::error("Packet is too small to contain an Ethernet header.");
-        return;
+    processPacket(std::move(packet), iface, routeCache);
+}
+
+void StaticRouter::handlePackets(std::span<PacketRef> packets) {
+    std::unique_lock lock(mutex);
+
+    processPackets(packets, routeCache);
+}
+
+void StaticRouter::processPacket(std::vector<uint8_t> packet, const std::string& iface, RouteCache& cache) {
+    PacketRef ref{packet, iface};
+    processPackets(std::span(&ref, 1), cache);
+}
+
+void StaticRouter::processPackets(std::span<PacketRef> packets, RouteCache& cache) {
+    for (size_t base = 0; base < packets.size(); base += MAX_BURST) {
+        processBurst(packets.subspan(base, std::min(MAX_BURST, packets.size() - base)), cache);
     }
+}
 
-    // Extract the Ethernet header from the packet
-    const sr_ethernet_hdr_t* ethHeader = reinterpret_cast<const sr_ethernet_hdr_t*>(packet.data());
+void StaticRouter::processBurst(std::span<PacketRef> burst, RouteCache& cache) {
+    // Stage 1: classify. ARP and other frames are handled as they are met; IPv4 frames
+    // are collected. An ARP reply thus takes effect before the burst's lookups.
+    std::array<size_t, MAX_BURST> ipv4;
+    std::array<const sr_ip_hdr_t*, MAX_BURST> headers;
+    size_t ipv4Count = 0;
+    for (size_t i = 0; i < burst.size(); ++i) {
+        const Packet& packet = burst[i].packet;
+        if (packet.size() < sizeof(sr_ethernet_hdr_t)) {
+            spdlog::error("Packet is too small to contain an Ethernet header.");
+            continue;
+        }
 
-    // Check the EtherType field
-    uint16_t etherType = ntohs(ethHeader->ether_type);
+        uint16_t etherType = ntohs(reinterpret_cast<const sr_ethernet_hdr_t*>(packet.data())->ether_type);
+        if (etherType == ETHERTYPE_ARP) {
+            spdlog::info("EtherType indicates ARP. Processing ARP packet...");
+            handleARP(packet, burst[i].iface);
+        }
+        else if (etherType == ETHERTYPE_IPv4) {
+            if (packet.size() < sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t)) {
+                spdlog::error("Packet is too small to contain an IP header.");
+                continue;
+            }
+            ipv4[ipv4Count] = i;
+            headers[ipv4Count++] = reinterpret_cast<const sr_ip_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
+        }
+        else {
+            spdlog::warn("Unsupported EtherType: 0x{:04x}. Discarding packet.", etherType);
+        }
+    }
 
-    // ARP
-    if (etherType == ETHERTYPE_ARP) {
-        spdlog::info("EtherType indicates ARP. Processing ARP packet...");
-        handleARP(packet, iface);
+    // Stage 2: verify all IPv4 headers in one pass
+    std::array<bool, MAX_BURST> valid;
+    checksum::verifyIpHeaders(std::span(headers.data(), ipv4Count), std::span(valid.data(), ipv4Count));
+
+    // Stage 3: packets for the router and packets whose TTL runs out take the single
+    // packet path; the rest are to be forwarded
+    std::array<size_t, MAX_BURST> forward;
+    std::array<ip_addr, MAX_BURST> destinations;
+    std::array<uint32_t, MAX_BURST> flowHashes;
+    size_t forwardCount = 0;
+    for (size_t j = 0; j < ipv4Count; ++j) {
+        PacketRef& ref = burst[ipv4[j]];
+        if (!valid[j]) {
+            spdlog::error("Invalid IP checksum. Discarding packet.");
+            continue;
+        }
+        if (headers[j]->ip_ttl <= 1 || isFinalDestination(headers[j])) {
+            handleIP(std::move(ref.packet), ref.iface, cache);
+            continue;
+        }
+        forward[forwardCount] = ipv4[j];
+        destinations[forwardCount] = headers[j]->ip_dst;
+        flowHashes[forwardCount++] = flow_hash(headers[j], ref.packet.size() - sizeof(sr_ethernet_hdr_t));
     }
-    // IPv4
-    else if (etherType == ETHERTYPE_IPv4) {
-        spdlog::info("EtherType indicates IPv4. Processing IP packet...");
-        handleIP(packet, iface);
+
+    // Stage 4: look up the routes of the burst together
+    std::array<uint32_t, MAX_BURST> nextHopIndices;
+    routingTable->lookupBatch(std::span(destinations.data(), forwardCount), std::span(nextHopIndices.data(), forwardCount),
+                              std::span(flowHashes.data(), forwardCount), cache);
+
+    // Stage 5: resolve each distinct next hop once. Bursts usually share a few.
+    struct ResolvedNextHop {
+        uint32_t index;
+        NextHop nextHop;
+        std::optional<mac_addr> mac; /**< The neighbor's MAC, if the ARP cache has it. */
+        mac_addr sourceMAC;          /**< The egress interface's MAC, if mac is set. */
+    };
+    std::array<ResolvedNextHop, MAX_BURST> resolved;
+    std::array<size_t, MAX_BURST> resolvedOf;
+    std::array<bool, MAX_BURST> done{};
+    size_t resolvedCount = 0;
+    for (size_t k = 0; k < forwardCount; ++k) {
+        uint32_t index = nextHopIndices[k];
+        PacketRef& ref = burst[forward[k]];
+        if (index == NO_NEXT_HOP) {
+            // Send ICMP message type 3 code 0
+            spdlog::error("No routing entry found for destination IP {}. Dropping packet.", destinations[k]);
+            auto* ethHeader = reinterpret_cast<const sr_ethernet_hdr_t*>(ref.packet.data());
+            auto* ipHeader = reinterpret_cast<const sr_ip_hdr_t*>(ref.packet.data() + sizeof(sr_ethernet_hdr_t));
+            sendICMPDestinationUnreachable(ipHeader, ethHeader, ref.iface);
+            done[k] = true;
+            continue;
+        }
+        routingTable->countRouted(index, ref.packet.size());
+
+        size_t r = 0;
+        while (r < resolvedCount && resolved[r].index != index) {
+            ++r;
+        }
+        if (r == resolvedCount) {
+            NextHop nextHop = routingTable->getNextHop(index);
+            std::optional<mac_addr> mac = arpCache->getEntry(nextHop.gateway);
+            mac_addr sourceMAC{};
+            if (mac) {
+                sourceMAC = routingTable->getRoutingInterface(routingTable->getInterfaceName(nextHop.iface)).mac;
+            }
+            resolved[resolvedCount++] = {index, nextHop, mac, sourceMAC};
+        }
+        resolvedOf[k] = r;
     }
-    else {
-        spdlog::warn("Unsupported EtherType: 0x{:04x}. Discarding packet.", etherType);
-        return;
+
+    // Stage 6: rewrite and send the frames grouped by egress interface, in arrival order
+    // within each interface and so within each flow. Frames without a neighbor MAC are queued.
+    std::array<Packet, MAX_BURST> outgoing;
+    for (size_t k = 0; k < forwardCount; ++k) {
+        if (done[k]) {
+            continue;
+        }
+        InterfaceId egress = resolved[resolvedOf[k]].nextHop.iface;
+        size_t outgoingCount = 0;
+        for (size_t m = k; m < forwardCount; ++m) {
+            const ResolvedNextHop& next = resolved[resolvedOf[m]];
+            if (done[m] || next.nextHop.iface != egress) {
+                continue;
+            }
+            done[m] = true;
+
+            PacketRef& ref = burst[forward[m]];
+            if (!next.mac) {
+                spdlog::info("MAC address not found in ARP cache. Queueing packet and sending ARP request.");
+                arpCache->queuePacket(next.nextHop.gateway, std::move(ref.packet), ref.iface);
+            }
+            else if (rewrite_for_next_hop(ref.packet, next.sourceMAC, *next.mac)) {
+                outgoing[outgoingCount++] = std::move(ref.packet);
+            }
+        }
+
+        if (outgoingCount > 0) {
+            spdlog::info("Sending {} packets found in the ARP cache right away", outgoingCount);
+            packetSender->sendPackets(std::span(outgoing.data(), outgoingCount), routingTable->getInterfaceName(egress));
+        }
     }
 }
 
@@ -67,6 +197,17 @@ void StaticRouter::handleARP(const std::vector<uint8_t>& packet, const std::stri
 
     const sr_arp_hdr_t* arpHeader = reinterpret_cast<const sr_arp_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
 
+    // Gratuitous ARP: a host announcing its own address to the whole link
+    if (arpHeader->ar_sip == arpHeader->ar_tip && !isARPPacketForRouter(arpHeader->ar_tip, iface)) {
+        mac_addr senderMAC;
+        std::copy(arpHeader->ar_sha, arpHeader->ar_sha + ETHER_ADDR_LEN, senderMAC.begin());
+        auto* concreteArpCache = dynamic_cast<ArpCache*>(arpCache.get());
+        if (concreteArpCache) {
+            concreteArpCache->learnNeighbor(arpHeader->ar_sip, senderMAC, iface);
+        }
+        return;
+    }
+
     // Check if the ARP packet is meant for this router
     if (!isARPPacketForRouter(arpHeader->ar_tip, iface)) {
         spdlog::info("Received ARP packet not intended for this router (Target IP: {}). Ignoring.", arpHeader->ar_tip);
@@ -86,6 +227,8 @@ void StaticRouter::handleARP(const std::vector<uint8_t>& packet, const std::stri
         auto* concreteArpCache = dynamic_cast<ArpCache*>(arpCache.get());
         if (concreteArpCache) {
             concreteArpCache->sendArpResponse(senderIP, senderMAC, iface);
+            // The sender is about to receive our traffic
+            concreteArpCache->learnNeighbor(senderIP, senderMAC, iface);
         }
         else {
             spdlog::error("Failed to cast arpCache to ArpCache.");
@@ -122,7 +265,11 @@ void StaticRouter::handleARP(const std::vector<uint8_t>& packet, const std::stri
     }
 }
 
-void StaticRouter::handleIP(const std::vector<uint8_t>& packet, const std::string& iface) {
+void StaticRouter::handleIP(std::vector<uint8_t> packet, const std::string& iface) {
+    handleIP(std::move(packet), iface, routeCache);
+}
+
+void StaticRouter::handleIP(std::vector<uint8_t> packet, const std::string& iface, RouteCache& cache) {
     spdlog::info("Handling IP packet on interface {}.", iface);
     print_hdrs((uint8_t*)packet.data(), sizeof(sr_ethernet_hdr) + sizeof(sr_ip_hdr) + sizeof(sr_icmp_hdr));
 
@@ -209,51 +356,40 @@ void StaticRouter::handleIP(const std::vector<uint8_t>& packet, const std::strin
             return;
         }
 
-        // Look up the destination in the routing table
-        auto route = routingTable->getRoutingEntry(destIP);
+        // Look up the destination in the routing table. The flow hash keeps every packet
+        // of a flow on the same path when the route has several equal-cost next hops.
+        uint32_t hash = flow_hash(ipHeader, packet.size() - sizeof(sr_ethernet_hdr_t));
+        uint32_t nextHopIndex = routingTable->lookupNextHop(destIP, hash, cache);
+
+        if (nextHopIndex != NO_NEXT_HOP) {
+            routingTable->countRouted(nextHopIndex, packet.size());
 
-        if (route) {
             // Get the next hop IP and check if it's in the ARP cache
             // If it's cached, forward the packet, if not send an ARP request
+            NextHop nextHop = routingTable->getNextHop(nextHopIndex);
+            const std::string& outIface = routingTable->getInterfaceName(nextHop.iface);
 
             // IP address of the next hop
-            uint32_t targetIP = route->gateway;
+            uint32_t targetIP = nextHop.gateway;
 
             // Check if it's in ARP Cache
             auto arpEntry = arpCache->getEntry(targetIP);
 
             if (arpEntry) {
-                auto* mutableIpHeader = const_cast<sr_ip_hdr_t*>(ipHeader);
-                mutableIpHeader->ip_ttl--;                                            // Decrement TTL by 1;
-                mutableIpHeader->ip_sum = 0;                                          // Reset checksum before recalculating
-                mutableIpHeader->ip_sum = cksum(mutableIpHeader, sizeof(sr_ip_hdr));  // Recompute the checksum
-
-                // In cache -> Forward it
-                mac_addr nextHopMAC = *arpEntry;
-
-                // Construct the Ethernet frame
-                size_t ethernetFrameSize = sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + ntohs(ipHeader->ip_len);
-                std::vector<uint8_t> ethernetFrame(ethernetFrameSize, 0);
-
-                // Fill the Ethernet header
-                sr_ethernet_hdr_t* ethHeader = reinterpret_cast<sr_ethernet_hdr_t*>(ethernetFrame.data());
-                auto ifaceInfo = routingTable->getRoutingInterface(route->iface);           // Get the interface info for source MAC
-                std::memcpy(ethHeader->ether_shost, ifaceInfo.mac.data(), ETHER_ADDR_LEN);  // Set source MAC address
-                std::memcpy(ethHeader->ether_dhost, nextHopMAC.data(), ETHER_ADDR_LEN);     // Set destination MAC address
-                ethHeader->ether_type = htons(ethertype_ip);                                // Indicating IP payload
-
-                // Copy the IP header and payload into the Ethernet frame
-                std::memcpy(ethernetFrame.data() + sizeof(sr_ethernet_hdr_t), ipHeader, ntohs(ipHeader->ip_len));
+                // In cache -> Forward it, rewriting the received frame in place
+                mac_addr sourceMAC = routingTable->getRoutingInterface(outIface).mac;  // Get the interface info for source MAC
+                if (!rewrite_for_next_hop(packet, sourceMAC, *arpEntry)) {
+                    return;
+                }
 
-                // 5. Send the packet through the correct interface
+                // 5. Send the packet through the correct interface, handing the buffer over
                 spdlog::info("MAC address found in ARP cache. Sending Packet right away");
-                print_hdrs((uint8_t*)ethernetFrame.data(), sizeof(sr_ethernet_hdr) + sizeof(sr_ip_hdr) + sizeof(sr_icmp_hdr));
-                packetSender->sendPacket(ethernetFrame, route->iface);
+                packetSender->sendPacket(std::move(packet), outIface);
             }
             else {
                 // Not in cache -> Queue the packet request
                 spdlog::info("MAC address not found in ARP cache. Queueing packet and sending ARP request.");
-                arpCache->queuePacket(targetIP, packet, iface);
+                arpCache->queuePacket(targetIP, std::move(packet), iface);
             }
         }
         else {
@@ -268,32 +404,13 @@ void StaticRouter::handleIP(const std::vector<uint8_t>& packet, const std::strin
 
 // Checks if the given checksum is valid for the ip packet
 bool StaticRouter::isValidIPChecksum(const sr_ip_hdr_t* ipHeader) {
-    // Save the original checksum
-    uint16_t originalChecksum = ipHeader->ip_sum;
-
-    // Temporarily set the checksum field to 0
-    sr_ip_hdr_t tempHeader = *ipHeader;
-    tempHeader.ip_sum = 0;
-
-    // Use the cksum function to compute the checksum
-    uint16_t computedChecksum = cksum(&tempHeader, sizeof(sr_ip_hdr_t));
-
-    // Return whether the computed checksum matches the original
-    return computedChecksum == originalChecksum;
+    // Sum the header in place, checksum field included
+    return ip_cksum_valid(ipHeader, sizeof(sr_ip_hdr_t));
 }
 
 bool StaticRouter::isFinalDestination(const sr_ip_hdr_t* ipHeader) {
-    // Store the interfaces into the variable
-    const auto interfaces = routingTable->getRoutingInterfaces();
-
     // Check if the destination IP matches any of the router's interfaces
-    for (const auto& ifaceEntry : interfaces) {
-        if (ipHeader->ip_dst == ifaceEntry.second.ip) {
-            return true;  // Found the destination IP match, this is the final destination
-        }
-    }
-
-    return false;  // No match, the packet is not meant for this router
+    return routingTable->isInterfaceAddress(ipHeader->ip_dst);
 }
 
 bool StaticRouter::isARPPacketForRouter(const uint32_t target_ip, const std::string& iface) {
@@ -2,11 +2,22 @@
 #define STATICROUTER_H
 #include <memory>
 #include <mutex>
+#include <span>
 #include <vector>
 
 #include "IArpCache.h"
 #include "IPacketSender.h"
 #include "IRoutingTable.h"
+#include "RouteCache.h"
+
+/**
+ * @struct PacketRef
+ * @brief A received frame in a burst handed to StaticRouter::handlePackets().
+ */
+struct PacketRef {
+    Packet& packet;           /**< Moved from when the router forwards or queues the frame. */
+    const std::string& iface; /**< The interface the frame was received on. */
+};
 
 class StaticRouter {
    public:
@@ -20,9 +31,38 @@ class StaticRouter {
      */
     void handlePacket(std::vector<uint8_t> packet, std::string iface);
 
+    /**
+     * @brief Handles a burst of incoming packets under one acquisition of the router's lock.
+     *
+     * ARP and other frames that are not IPv4 are handled as they are met. The IPv4
+     * headers of the burst are then checked together, the routes and neighbors of the
+     * packets to forward are looked up together, and those packets are sent grouped by
+     * egress interface, in arrival order within each interface. handlePacket() is the
+     * burst of one.
+     * @param packets The burst, in arrival order.
+     */
+    void handlePackets(std::span<PacketRef> packets);
+
+    /**
+     * @brief Like handlePacket(), but without the router's lock, for several threads at
+     * once.
+     *
+     * Everything the packet path shares is synchronized by its owner, except the route
+     * cache, so each calling thread passes its own.
+     * @param cache The calling thread's own route cache.
+     */
+    void processPacket(std::vector<uint8_t> packet, const std::string& iface, RouteCache& cache);
+
+    /**
+     * @brief Like handlePackets(), but without the router's lock; see processPacket().
+     */
+    void processPackets(std::span<PacketRef> packets, RouteCache& cache);
+
     void handleARP(const std::vector<uint8_t>& packet, const std::string& iface);
 
-    void handleIP(const std::vector<uint8_t>& packet, const std::string& iface);
+    void handleIP(std::vector<uint8_t> packet, const std::string& iface);
+
+    void handleIP(std::vector<uint8_t> packet, const std::string& iface, RouteCache& cache);
 
     bool isValidIPChecksum(const sr_ip_hdr_t* ipHeader);
 
@@ -38,13 +78,26 @@ class StaticRouter {
 
     void sendICMPTimeExceeded(const sr_ip_hdr_t* ipHeader, const sr_ethernet_hdr_t* originalEthHeader, const std::string& iface);
 
+    /**
+     * @brief Hits and misses of the destination cache used by handlePacket() and
+     * handlePackets(). Callers of processPacket() keep their own caches.
+     */
+    RouteCacheStats routeCacheStats() const { return routeCache.stats(); }
+
    private:
+    /** Packets processed together; longer bursts are split. Bounds the stack arrays of a burst. */
+    static constexpr size_t MAX_BURST = 64;
+
+    void processBurst(std::span<PacketRef> burst, RouteCache& cache);
+
     std::mutex mutex;
 
     std::shared_ptr<IRoutingTable> routingTable;
     std::shared_ptr<IPacketSender> packetSender;
 
     std::unique_ptr<IArpCache> arpCache;
+
+    RouteCache routeCache; /**< Used by handlePacket() under mutex. */
 };
 
 #endif  // STATICROUTER_H
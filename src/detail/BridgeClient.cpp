@@ -10,15 +10,32 @@
 
 // Constructor
 BridgeClient::BridgeClient(std::filesystem::path routingTablePath,
-                           std::string pcapPrefix)
-    : dumper(pcapPrefix + "_input.pcap") {
-    routingTable = std::make_shared<RoutingTable>(routingTablePath);
+                           std::string pcapPrefix, FibEngine fibEngine, AggregationOptions fibAggregation,
+                           ArpCacheOptions arpOptions,
+                           std::filesystem::path fibSnapshotPath, size_t forwardingWorkers)
+    : resolveGatewaysEnabled(arpOptions.resolveGateways), dumper(pcapPrefix + "_input.pcap") {
+    if (fibSnapshotPath.empty()) {
+        routingTable = std::make_shared<RoutingTable>(routingTablePath, fibEngine, fibAggregation);
+    } else {
+        routingTable = std::make_shared<RoutingTable>(FibSnapshot(fibSnapshotPath));
+    }
 
     client = std::make_shared<WSClient>();
     client->init_asio();
     client->clear_access_channels(websocketpp::log::alevel::all);
     client->clear_error_channels(websocketpp::log::elevel::all);
 
+    // Stop the event loop on SIGINT and SIGTERM so that run() returns and the router is
+    // torn down normally, saving the ARP cache on the way
+    terminationSignals =
+        std::make_unique<websocketpp::lib::asio::signal_set>(client->get_io_service(), SIGINT, SIGTERM);
+    terminationSignals->async_wait([this](const auto& error, int signal) {
+        if (!error) {
+            spdlog::info("Received signal {}, shutting down.", signal);
+            client->stop();
+        }
+    });
+
     // Set handlers before creating the connection
     client->set_message_handler([this](auto hdl, WSClient::message_ptr msg) {
         onMessage(msg->get_payload());
@@ -39,9 +56,18 @@ BridgeClient::BridgeClient(std::filesystem::path routingTablePath,
 
     auto bridgeSender = std::make_shared<BridgeSender>(client, con, pcapPrefix);
     auto arpCache = std::make_unique<ArpCache>(std::chrono::seconds(15),
-                                               bridgeSender, routingTable);
+                                               bridgeSender, routingTable, arpOptions);
+    this->arpCache = arpCache.get();
     staticRouter = std::make_unique<StaticRouter>(std::move(arpCache),
                                                   routingTable, bridgeSender);
+    if (forwardingWorkers > 0) {
+        forwardingPool = std::make_unique<ForwardingPool>(*staticRouter, forwardingWorkers);
+    }
+
+    // Started once the ARP cache exists, so a reload can resolve the new gateways. A table
+    // started from a FIB snapshot is not reloaded from the routing table file.
+    watcher = std::make_unique<RoutingTableWatcher>(fibSnapshotPath.empty() ? routingTablePath : std::filesystem::path(),
+                                                    routingTable, [this] { resolveGateways(); }, [this] { logStats(); });
 
     client->connect(con);
 }
@@ -49,14 +75,48 @@ BridgeClient::BridgeClient(std::filesystem::path routingTablePath,
 // Method to request interfaces
 void BridgeClient::setInterfaces(
     const router_bridge::InterfaceUpdate& interfaces) {
+    std::vector<RoutingInterface> update;
     for (const auto& iface : interfaces.interfaces()) {
         mac_addr mac;
         std::copy(iface.mac().begin(), iface.mac().begin() + mac.size(),
                   mac.begin());
-        routingTable->setRoutingInterface(iface.name(), mac, iface.ip());
+        update.push_back({iface.name(), mac, iface.ip()});
     }
 
+    // Publish all interfaces at once so the router never sees half of the update
+    routingTable->setRoutingInterfaces(update);
+
     spdlog::info("Set interfaces, router ready to route things!");
+
+    // Restored neighbors are confirmed from the interfaces; gateways among them need no request
+    if (!snapshotRestored) {
+        snapshotRestored = true;
+        arpCache->restoreSnapshot();
+    }
+
+    interfacesSet = true;
+    resolveGateways();
+}
+
+void BridgeClient::resolveGateways() {
+    // ARP requests are sent from the interfaces, so wait until they are known
+    if (resolveGatewaysEnabled && interfacesSet) {
+        arpCache->resolveGateways(routingTable->getGateways());
+    }
+}
+
+void BridgeClient::logStats() {
+    RouteCacheStats cache = staticRouter->routeCacheStats();
+    if (forwardingPool) {
+        cache += forwardingPool->routeCacheStats();
+    }
+    uint64_t lookups = cache.hits + cache.misses;
+    spdlog::info("Route cache: {} hits, {} misses ({:.1f}% hit rate).", cache.hits, cache.misses,
+                 lookups ? 100.0 * cache.hits / lookups : 0.0);
+
+    PendingPacketStats pending = arpCache->pendingStats();
+    spdlog::info("ARP queues: {} packets ({} bytes) waiting; {} tail drops, {} head drops ({} bytes dropped).",
+                 pending.packets, pending.bytes, pending.tailDrops, pending.headDrops, pending.droppedBytes);
 }
 
 void BridgeClient::onMessage(const std::string& message) {
@@ -69,7 +129,11 @@ void BridgeClient::onMessage(const std::string& message) {
                                     packetMessage.data().end());
         dumper.dump(packet);
 
-        staticRouter->handlePacket(packet, packetMessage.interface());
+        if (forwardingPool) {
+            forwardingPool->dispatch(std::move(packet), packetMessage.interface());
+        } else {
+            staticRouter->handlePacket(std::move(packet), packetMessage.interface());
+        }
     } else if (protoMessage.has_interface_update()) {
         setInterfaces(protoMessage.interface_update());
     }
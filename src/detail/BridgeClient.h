@@ -6,8 +6,11 @@
 #include <websocketpp/client.hpp>
 #include <websocketpp/config/asio_no_tls_client.hpp>
 
+#include "ArpCache.h"
+#include "ForwardingPool.h"
 #include "PCAPDumper.h"
 #include "RoutingTable.h"
+#include "RoutingTableWatcher.h"
 #include "StaticRouter.h"
 #include "router_bridge.pb.h"
 
@@ -16,7 +19,9 @@ class BridgeClient {
 
    public:
     BridgeClient(std::filesystem::path routingTablePath,
-                 std::string pcapPrefix);
+                 std::string pcapPrefix, FibEngine fibEngine, AggregationOptions fibAggregation,
+                 ArpCacheOptions arpOptions,
+                 std::filesystem::path fibSnapshotPath = {}, size_t forwardingWorkers = 0);
 
     void setInterfaces(const router_bridge::InterfaceUpdate& interfaces);
 
@@ -25,10 +30,23 @@ class BridgeClient {
    private:
     void onMessage(const std::string& message);
 
+    /** Resolves the gateways of the routing table if enabled and the interfaces are known. */
+    void resolveGateways();
+
+    /** Logs the route cache and ARP queue counters, on SIGUSR1. */
+    void logStats();
+
     std::shared_ptr<WSClient> client;
+    std::unique_ptr<websocketpp::lib::asio::signal_set> terminationSignals; /**< SIGINT and SIGTERM stop run(). */
 
     std::shared_ptr<RoutingTable> routingTable;
     std::unique_ptr<StaticRouter> staticRouter;
+    ArpCache* arpCache = nullptr; /**< Owned by staticRouter. */
+    std::unique_ptr<ForwardingPool> forwardingPool; /**< Null when forwarding on the websocket thread. */
+    bool resolveGatewaysEnabled = false;
+    std::atomic<bool> interfacesSet = false;
+    bool snapshotRestored = false;
+    std::unique_ptr<RoutingTableWatcher> watcher; /**< Declared after staticRouter so its thread stops first. */
 
     PcapDumper dumper;
 };
@@ -1,5 +1,7 @@
 #include "BridgeSender.h"
 
+#include <vector>
+
 BridgeSender::BridgeSender(std::shared_ptr<WSClient> client,
                            WSClient::connection_ptr connection,
                            std::string pcapPrefix)
@@ -14,10 +16,30 @@ void BridgeSender::sendPacket(Packet packet, const std::string& iface) {
     routerPacket.set_interface(iface);
     routerPacket.set_data(packet.data(), packet.size());
 
+    std::lock_guard lock(mutex);
     dumper.dump(packet);
     send(message);
 }
 
+void BridgeSender::sendPackets(std::span<Packet> packets, const std::string& iface) {
+    std::vector<std::string> messages;
+    messages.reserve(packets.size());
+    for (const Packet& packet : packets) {
+        router_bridge::ProtocolMessage message;
+        RouterPacket& routerPacket = *message.mutable_router_packet();
+
+        routerPacket.set_interface(iface);
+        routerPacket.set_data(packet.data(), packet.size());
+        messages.push_back(message.SerializeAsString());
+    }
+
+    std::lock_guard lock(mutex);
+    for (size_t i = 0; i < packets.size(); ++i) {
+        dumper.dump(packets[i]);
+        client->send(connection, messages[i], websocketpp::frame::opcode::binary);
+    }
+}
+
 void BridgeSender::send(const router_bridge::ProtocolMessage& message) {
     client->send(connection, message.SerializeAsString(),
                  websocketpp::frame::opcode::binary);
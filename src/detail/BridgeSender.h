@@ -2,6 +2,8 @@
 #define BRIDGESENDER_H
 #include <router_bridge.pb.h>
 
+#include <mutex>
+
 #include <websocketpp/client.hpp>
 #include <websocketpp/config/asio_no_tls_client.hpp>
 
@@ -18,12 +20,18 @@ class BridgeSender : public IPacketSender {
 
     void sendPacket(Packet packet, const std::string& iface) override;
 
+    /**
+     * @brief Serializes the packets first, then sends them all under one lock.
+     */
+    void sendPackets(std::span<Packet> packets, const std::string& iface) override;
+
    private:
     void send(const router_bridge::ProtocolMessage& message);
 
     std::shared_ptr<WSClient> client;
     WSClient::connection_ptr connection;
 
+    std::mutex mutex; /**< Packets come from forwarding workers and the ARP thread at once. */
     PcapDumper dumper;
 };
 
@@ -9,10 +9,54 @@ int main(int argc, char **argv)
     options.add_options()
         ("h,help", "Print help")
         ("r,routing-table", "Path to routing table", cxxopts::value<std::string>()->default_value("rtable"))
-        ("p,pcap-prefix", "Prefix for pcap files", cxxopts::value<std::string>()->default_value("sr_capture"));
+        ("p,pcap-prefix", "Prefix for pcap files", cxxopts::value<std::string>()->default_value("sr_capture"))
+        ("f,fib", "Route lookup engine (linear, dir24-8)", cxxopts::value<std::string>()->default_value("dir24-8"))
+        ("fib-aggregate", "Aggregate prefixes that share a next hop before compiling the FIB; route updates then recompile it whole")
+        ("fib-verify", "Check the aggregated FIB against the routing table at startup and on reload (none, random, exhaustive)", cxxopts::value<std::string>()->default_value("none"))
+        ("fib-snapshot", "Start from a FIB snapshot instead of compiling the routing table, which is then not reloaded", cxxopts::value<std::string>()->default_value(""))
+        ("w,workers", "Forwarding threads; 0 forwards on the bridge thread", cxxopts::value<size_t>()->default_value("0"))
+        ("arp-capacity", "ARP cache slots, a power of two; neighbors are evicted once 7/8 are used", cxxopts::value<size_t>()->default_value("4096"))
+        ("arp-queue-packets", "Packets waiting for ARP resolution, across all next hops", cxxopts::value<size_t>()->default_value("4096"))
+        ("arp-queue-bytes", "Bytes waiting for ARP resolution, across all next hops", cxxopts::value<size_t>()->default_value("4194304"))
+        ("arp-queue-hop-packets", "Packets waiting for a single next hop", cxxopts::value<size_t>()->default_value("64"))
+        ("arp-queue-hop-bytes", "Bytes waiting for a single next hop", cxxopts::value<size_t>()->default_value("65536"))
+        ("arp-queue-policy", "Packet dropped when an ARP queue is full (tail, head)", cxxopts::value<std::string>()->default_value("tail"))
+        ("arp-resolve-gateways", "Resolve every routing table gateway at startup and after reloads, and keep them resolved")
+        ("arp-broadcast-rate", "ARP requests broadcast per second on each interface", cxxopts::value<double>()->default_value("200"))
+        ("arp-broadcast-burst", "ARP requests an idle interface may broadcast at once", cxxopts::value<size_t>()->default_value("64"))
+        ("arp-snapshot", "File the ARP cache is saved to and restored from across restarts", cxxopts::value<std::string>()->default_value(""))
+        ("arp-snapshot-interval", "Milliseconds between two ARP cache saves", cxxopts::value<uint32_t>()->default_value("60000"))
+        ("arp-learn", "Learn neighbors from ARP requests to the router and from gratuitous ARP")
+        ("arp-hold-down", "Milliseconds a next hop that did not answer ARP stays unreachable (0 disables)", cxxopts::value<uint32_t>()->default_value("5000"))
+        ("compile-fib", "Compile the routing table into a FIB snapshot at the given path and exit", cxxopts::value<std::string>());
 
     auto result = options.parse(argc, argv);
+    FibEngine engine = parseFibEngine(result["fib"].as<std::string>());
+    AggregationOptions aggregation{result.count("fib-aggregate") > 0,
+                                   parseFibVerifyMode(result["fib-verify"].as<std::string>())};
 
-    BridgeClient client(result["routing-table"].as<std::string>(), result["pcap-prefix"].as<std::string>());
+    ArpCacheOptions arpOptions;
+    arpOptions.capacity = result["arp-capacity"].as<size_t>();
+    arpOptions.pending.packets = result["arp-queue-packets"].as<size_t>();
+    arpOptions.pending.bytes = result["arp-queue-bytes"].as<size_t>();
+    arpOptions.pending.packetsPerQueue = result["arp-queue-hop-packets"].as<size_t>();
+    arpOptions.pending.bytesPerQueue = result["arp-queue-hop-bytes"].as<size_t>();
+    arpOptions.pending.policy = parseQueueDropPolicy(result["arp-queue-policy"].as<std::string>());
+    arpOptions.holdDown = std::chrono::milliseconds(result["arp-hold-down"].as<uint32_t>());
+    arpOptions.resolveGateways = result.count("arp-resolve-gateways") > 0;
+    arpOptions.broadcastRate = result["arp-broadcast-rate"].as<double>();
+    arpOptions.broadcastBurst = result["arp-broadcast-burst"].as<size_t>();
+    arpOptions.snapshotPath = result["arp-snapshot"].as<std::string>();
+    arpOptions.snapshotInterval = std::chrono::milliseconds(result["arp-snapshot-interval"].as<uint32_t>());
+    arpOptions.learnNeighbors = result.count("arp-learn") > 0;
+
+    if (result.count("compile-fib")) {
+        RoutingTable routingTable(result["routing-table"].as<std::string>(), engine, aggregation);
+        routingTable.writeSnapshot(result["compile-fib"].as<std::string>());
+        return 0;
+    }
+
+    BridgeClient client(result["routing-table"].as<std::string>(), result["pcap-prefix"].as<std::string>(), engine,
+                        aggregation, arpOptions, result["fib-snapshot"].as<std::string>(), result["workers"].as<size_t>());
     client.run();
 }
\ No newline at end of file
@@ -2,22 +2,83 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cstring>
+
+#include "Checksum.h"
 #include "protocol.h"
 
 uint16_t cksum (const void *_data, int len) {
-  const uint8_t *data = static_cast<const uint8_t*>(_data);
-  uint32_t sum;
-
-  for (sum = 0;len >= 2; data += 2, len -= 2)
-    sum += data[0] << 8 | data[1];
-  if (len > 0)
-    sum += data[0] << 8;
-  while (sum > 0xffff)
-    sum = (sum >> 16) + (sum & 0xffff);
-  sum = htons (~sum);
+  /* The widest kernel the CPU supports does the summing */
+  uint16_t sum = htons (static_cast<uint16_t>(~checksum::sum(_data, len)));
   return sum ? sum : 0xffff;
 }
 
+bool ip_cksum_valid(const void *ip_hdr, int len) {
+  return checksum::sum(ip_hdr, len) == 0xffff;
+}
+
+uint16_t cksum_update(uint16_t sum, uint16_t old_word, uint16_t new_word) {
+  /* HC' = ~(~HC + ~m + m'); two folds absorb every carry of three 16-bit terms */
+  uint32_t acc = static_cast<uint16_t>(~ntohs(sum)) + static_cast<uint16_t>(~ntohs(old_word)) + ntohs(new_word);
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+  uint16_t updated = htons(static_cast<uint16_t>(~acc));
+  return updated ? updated : 0xffff;
+}
+
+void ip_decrement_ttl(void *ip_hdr) {
+  auto *iphdr = static_cast<sr_ip_hdr_t*>(ip_hdr);
+
+  /* TTL shares its 16-bit word with the protocol field */
+  uint16_t old_word = htons(iphdr->ip_ttl << 8 | iphdr->ip_p);
+  iphdr->ip_ttl--;
+  uint16_t new_word = htons(iphdr->ip_ttl << 8 | iphdr->ip_p);
+  iphdr->ip_sum = cksum_update(iphdr->ip_sum, old_word, new_word);
+}
+
+bool rewrite_for_next_hop(Packet &packet, const mac_addr &source_mac, const mac_addr &next_hop_mac) {
+  auto *iphdr = reinterpret_cast<sr_ip_hdr_t*>(packet.data() + sizeof(sr_ethernet_hdr_t));
+  size_t ip_len = ntohs(iphdr->ip_len);
+  size_t hdr_len = std::max<size_t>(iphdr->ip_hl * 4, sizeof(sr_ip_hdr_t));
+  if (ip_len < hdr_len || sizeof(sr_ethernet_hdr_t) + ip_len > packet.size()) {
+    spdlog::error("IP length {} does not fit the frame and header. Dropping packet.", ip_len);
+    return false;
+  }
+  packet.resize(sizeof(sr_ethernet_hdr_t) + ip_len);  /* Drop any Ethernet padding; never reallocates */
+
+  ip_decrement_ttl(iphdr);
+
+  /* The EtherType stays IPv4 */
+  auto *ethhdr = reinterpret_cast<sr_ethernet_hdr_t*>(packet.data());
+  memcpy(ethhdr->ether_shost, source_mac.data(), ETHER_ADDR_LEN);
+  memcpy(ethhdr->ether_dhost, next_hop_mac.data(), ETHER_ADDR_LEN);
+
+  print_hdrs(packet.data(), packet.size());
+  return true;
+}
+
+uint32_t flow_hash(const void *ip_hdr, size_t len) {
+  const auto *iphdr = static_cast<const sr_ip_hdr_t*>(ip_hdr);
+
+  /* Fragments after the first carry no ports, so no fragment may use them */
+  uint32_t ports = 0;
+  size_t hdr_len = iphdr->ip_hl * 4;
+  bool fragment = (ntohs(iphdr->ip_off) & (IP_MF | IP_OFFMASK)) != 0;
+  if ((iphdr->ip_p == ip_protocol_tcp || iphdr->ip_p == ip_protocol_udp) && !fragment && len >= hdr_len + 4)
+    memcpy(&ports, static_cast<const uint8_t*>(ip_hdr) + hdr_len, sizeof(ports));
+
+  /* Fold the tuple into 64 bits and finish with the MurmurHash3 mixer */
+  uint64_t h = (static_cast<uint64_t>(iphdr->ip_src) << 32) | iphdr->ip_dst;
+  h ^= (static_cast<uint64_t>(ports) << 8 | iphdr->ip_p) * 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return static_cast<uint32_t>(h);
+}
+
 /* Converts a MAC address from void* to mac_addr */
 mac_addr make_mac_addr(void* addr) {
   mac_addr mac;
@@ -41,6 +102,8 @@ uint8_t ip_protocol(uint8_t* buf) {
 
 /* Prints out formatted Ethernet address, e.g. 00:11:22:33:44:55 */
 void print_addr_eth(uint8_t* addr) {
+  if (!spdlog::should_log(spdlog::level::info))
+    return;
   int pos = 0;
   uint8_t cur;
   std::string eth_addr;
@@ -135,6 +198,10 @@ void print_hdr_arp(uint8_t* buf) {
 
 /* Prints out all possible headers, starting from Ethernet */
 void print_hdrs(uint8_t* buf, uint32_t length) {
+  /* The dump is all info level; skip it on the forwarding path when that is off */
+  if (!spdlog::should_log(spdlog::level::info))
+    return;
+
   /* Ethernet */
   int minlength = sizeof(sr_ethernet_hdr_t);
   if (length < minlength) {
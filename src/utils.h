@@ -7,6 +7,24 @@
 #include "RouterTypes.h"
 
 uint16_t cksum(const void *_data, int len);
+
+/* Checks an IP header checksum in place: the sum over the header including ip_sum must be all ones */
+bool ip_cksum_valid(const void *ip_hdr, int len);
+
+/* Adjusts a checksum for one 16-bit word changing from old_word to new_word (RFC 1624, eqn. 3).
+   All values are in network byte order; the result matches what cksum would compute. */
+uint16_t cksum_update(uint16_t sum, uint16_t old_word, uint16_t new_word);
+
+/* Decrements the TTL of an IP header and updates ip_sum incrementally */
+void ip_decrement_ttl(void *ip_hdr);
+
+/* Rewrites a received IPv4 frame in place for its next hop: trims Ethernet padding, decrements
+   the TTL and sets both MAC addresses. Returns false, leaving the frame to be dropped, if its
+   IP length is shorter than its header or longer than the frame. */
+bool rewrite_for_next_hop(Packet &packet, const mac_addr &source_mac, const mac_addr &next_hop_mac);
+
+/* Hashes the 5-tuple of an IPv4 packet (3-tuple for fragments and other protocols) */
+uint32_t flow_hash(const void *ip_hdr, size_t len);
 mac_addr make_mac_addr(void* addr);
 
 void print_addr_eth(uint8_t *addr);